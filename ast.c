@@ -0,0 +1,318 @@
+#include <assert.h>
+#include "mcc.h"
+
+/*
+ * compact syntax trees
+ * the tree of a function body is copied into arrays indexed by node
+ * number, 0 being no node.  the operands of node n are operand[first[n]]
+ * up to operand[first[n+1]]: the numbers of its children, after the
+ * data of a leaf or scope (an integer, or the number of a symbol or
+ * symbol table in object).  the statements of a compound statement and
+ * the list of arguments of a call become its operands, so NK_ARG nodes
+ * are not kept.  kinds, locations and types are separate arrays, so a
+ * walk looking at kinds only touches a byte per node.
+ *
+ * the first operands of an operator, and theirs in turn, are numbered
+ * one after another: the first operand of node n is n + 1.  a long
+ * chain like a+b+c+... is walked down by counting, and up again by
+ * counting back, with no recursion or stack (see ast_chain()).
+ */
+
+struct ast {
+    AST_NODE root;
+    unsigned n_node;
+    unsigned n_operand;
+    unsigned n_object;
+    unsigned n_tree;            /* nodes of the tree it was made from */
+    unsigned char *kind;
+    unsigned *first;
+    unsigned *operand;
+    SRCLOC *loc;
+    TYPE **type;
+    void **object;
+};
+
+/* operands of the kind that are not children */
+static unsigned n_data(NODE_KIND kind)
+{
+    return (kind == NK_ID || kind == NK_INT_LIT || kind == NK_COMPOUND);
+}
+
+static unsigned count_args(const NODE *np)
+{
+    if (np == NULL)
+        return 0;
+    if (np->kind == NK_ARG)
+        return count_args(np->u.link.n1) + count_args(np->u.link.n2);
+    return 1;
+}
+
+static unsigned count_operands(const NODE *np)
+{
+    switch (np->kind) {
+    case NK_COMPOUND:
+        return 1 + np->u.comp.count;
+    case NK_CALL:
+        return 1 + count_args(np->u.link.n2);
+    case NK_ID:
+    case NK_INT_LIT:
+    case NK_RETURN:
+    case NK_EXPR:
+    case NK_ADDR:
+    case NK_INDIR:
+    case NK_MINUS:
+    case NK_NOT:
+        return 1;
+    case NK_WHILE:
+        return 2;
+    case NK_IF:
+        return 3;
+    case NK_FOR:
+        return 4;
+    case NK_CONTINUE:
+    case NK_BREAK:
+        return 0;
+    case NK_LINK:
+    case NK_ARG:
+        assert(0);
+        return 0;
+    default:
+        return 2;
+    }
+}
+
+/* nodes whose first operand is chained: the one after them in number */
+static bool is_chained(const NODE *np)
+{
+    switch (np->kind) {
+    case NK_COMPOUND:
+    case NK_CALL:
+    case NK_ID:
+    case NK_INT_LIT:
+    case NK_ARG:
+    case NK_CONTINUE:
+    case NK_BREAK:
+        return false;
+    default:
+        return np->u.link.n1 != NULL;
+    }
+}
+
+/* the first operands are looped over, the others recursed into */
+static void count_tree(AST *ast, const NODE *np)
+{
+    unsigned i;
+
+    for (; np != NULL; np = is_chained(np) ? np->u.link.n1 : NULL) {
+        ast->n_tree++;
+        if (np->kind != NK_ARG) {
+            ast->n_node++;
+            ast->n_operand += count_operands(np);
+            ast->n_object += n_data(np->kind) && np->kind != NK_INT_LIT;
+        }
+        switch (np->kind) {
+        case NK_COMPOUND:
+            for (i = 0; i < np->u.comp.count; i++)
+                count_tree(ast, np->u.comp.stmt[i]);
+            break;
+        case NK_ID:
+        case NK_INT_LIT:
+            break;
+        case NK_CALL:
+        case NK_ARG:
+            count_tree(ast, np->u.link.n1);
+            count_tree(ast, np->u.link.n2);
+            break;
+        default:
+            count_tree(ast, np->u.link.n2);
+            count_tree(ast, np->u.link.n3);
+            count_tree(ast, np->u.link.n4);
+            break;
+        }
+    }
+}
+
+static AST_NODE fill(AST *ast, const NODE *np);
+
+static void fill_args(AST *ast, const NODE *np, unsigned *op)
+{
+    if (np == NULL)
+        return;
+    if (np->kind == NK_ARG) {
+        fill_args(ast, np->u.link.n1, op);
+        fill_args(ast, np->u.link.n2, op);
+    } else
+        ast->operand[(*op)++] = fill(ast, np);
+}
+
+/*
+ * nodes are numbered before their children: first the chain of first
+ * operands from np down, then, going down the chain again, the other
+ * operands of each.
+ */
+static AST_NODE fill(AST *ast, const NODE *np)
+{
+    AST_NODE n, top;
+    unsigned op, i;
+    const NODE *p, *child[4];
+
+    if (np == NULL)
+        return 0;
+    top = ast->n_node + 1;
+    for (p = np; p != NULL; p = is_chained(p) ? p->u.link.n1 : NULL) {
+        n = ++ast->n_node;
+        ast->kind[n] = p->kind;
+        ast->loc[n] = p->loc;
+        ast->type[n] = p->type;
+        op = ast->first[n] = ast->n_operand;
+        ast->n_operand += count_operands(p);
+        if (is_chained(p))
+            ast->operand[op] = n + 1;
+    }
+    for (p = np, n = top; p != NULL; p = child[0], n++) {
+        op = ast->first[n];
+        child[0] = NULL;
+        switch (p->kind) {
+        case NK_COMPOUND:
+            ast->object[ast->n_object] = p->u.comp.symtab;
+            ast->operand[op++] = ast->n_object++;
+            for (i = 0; i < p->u.comp.count; i++)
+                ast->operand[op++] = fill(ast, p->u.comp.stmt[i]);
+            break;
+        case NK_CALL:
+            ast->operand[op++] = fill(ast, p->u.link.n1);
+            fill_args(ast, p->u.link.n2, &op);
+            break;
+        case NK_ID:
+            ast->object[ast->n_object] = p->u.sym;
+            ast->operand[op] = ast->n_object++;
+            break;
+        case NK_INT_LIT:
+            ast->operand[op] = (unsigned) p->u.num;
+            break;
+        case NK_CONTINUE:
+        case NK_BREAK:
+            break;
+        default:
+            child[1] = p->u.link.n2;
+            child[2] = p->u.link.n3;
+            child[3] = p->u.link.n4;
+            if (p->u.link.n1 == NULL)
+                ast->operand[op] = 0;
+            for (i = 1; i < count_operands(p); i++)
+                ast->operand[op + i] = fill(ast, child[i]);
+            child[0] = p->u.link.n1;
+            break;
+        }
+    }
+    return top;
+}
+
+/* the compact copy of the tree, allocated from a */
+AST *new_ast(ARENA *a, const NODE *np)
+{
+    AST *ast = (AST*) arena_alloc(a, sizeof (AST));
+    unsigned size;
+
+    ast->n_node = ast->n_operand = ast->n_object = ast->n_tree = 0;
+    count_tree(ast, np);
+    size = ast->n_node + 1;
+    ast->kind = (unsigned char*) arena_alloc(a, size);
+    ast->first = (unsigned*) arena_alloc(a, (size + 1) * sizeof (unsigned));
+    ast->operand = (unsigned*) arena_alloc(a,
+                                           ast->n_operand * sizeof (unsigned));
+    ast->loc = (SRCLOC*) arena_alloc(a, size * sizeof (SRCLOC));
+    ast->type = (TYPE**) arena_alloc(a, size * sizeof (TYPE*));
+    ast->object = (void**) arena_alloc(a, ast->n_object * sizeof (void*));
+    ast->kind[0] = NK_LINK;
+    ast->loc[0] = 0;
+    ast->type[0] = NULL;
+    ast->first[0] = 0;
+
+    ast->n_node = ast->n_operand = ast->n_object = 0;
+    ast->root = fill(ast, np);
+    ast->first[ast->n_node + 1] = ast->n_operand;
+    return ast;
+}
+
+AST_NODE ast_root(const AST *ast)
+{
+    return ast->root;
+}
+
+NODE_KIND ast_kind(const AST *ast, AST_NODE n)
+{
+    return (NODE_KIND) ast->kind[n];
+}
+
+SRCLOC ast_loc(const AST *ast, AST_NODE n)
+{
+    return ast->loc[n];
+}
+
+TYPE *ast_type(const AST *ast, AST_NODE n)
+{
+    return ast->type[n];
+}
+
+/* number of children, of a compound statement or call in particular */
+unsigned ast_count(const AST *ast, AST_NODE n)
+{
+    return ast->first[n + 1] - ast->first[n] - n_data(ast->kind[n]);
+}
+
+/*
+ * the chain of first operands of n, while of kinds in_chain() accepts:
+ * they are n + 1 up to the number returned, the innermost.
+ */
+AST_NODE ast_chain(const AST *ast, AST_NODE n, bool (*in_chain)(NODE_KIND))
+{
+    while (in_chain((NODE_KIND) ast->kind[n]) && ast_child(ast, n, 0) != 0) {
+        assert(ast_child(ast, n, 0) == n + 1);
+        n++;
+    }
+    return n;
+}
+
+/* the i-th child, 0 when it is left out */
+AST_NODE ast_child(const AST *ast, AST_NODE n, unsigned i)
+{
+    assert(i < ast_count(ast, n));
+    return ast->operand[ast->first[n] + n_data(ast->kind[n]) + i];
+}
+
+int ast_num(const AST *ast, AST_NODE n)
+{
+    assert(ast->kind[n] == NK_INT_LIT);
+    return (int) ast->operand[ast->first[n]];
+}
+
+SYMBOL *ast_sym(const AST *ast, AST_NODE n)
+{
+    assert(ast->kind[n] == NK_ID);
+    return (SYMBOL*) ast->object[ast->operand[ast->first[n]]];
+}
+
+SYMTAB *ast_symtab(const AST *ast, AST_NODE n)
+{
+    assert(ast->kind[n] == NK_COMPOUND);
+    return (SYMTAB*) ast->object[ast->operand[ast->first[n]]];
+}
+
+/* bytes for each node, here and in the tree it was copied from */
+void print_ast_stats(const char *id, const AST *ast)
+{
+    size_t bytes = sizeof (AST)
+        + (ast->n_node + 1) * (sizeof (char) + sizeof (unsigned)
+                               + sizeof (SRCLOC) + sizeof (TYPE*))
+        + sizeof (unsigned) + ast->n_operand * sizeof (unsigned)
+        + ast->n_object * sizeof (void*);
+    size_t tree = ast->n_tree * sizeof (NODE);
+
+    printf("ast %s: %u nodes, %lu bytes, %.1f per node; "
+            "tree %u nodes, %lu bytes, %.1f per node\n", id,
+            ast->n_node, (unsigned long) bytes,
+            ast->n_node ? (double) bytes / ast->n_node : 0.0,
+            ast->n_tree, (unsigned long) tree,
+            ast->n_node ? (double) tree / ast->n_node : 0.0);
+}
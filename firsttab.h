@@ -0,0 +1,424 @@
+/* generated by mkfirst from syntax.ansic.txt -- do not edit */
+
+enum {
+    NT_TRANSLATION_UNIT,
+    NT_EXTERNAL_DECLARATION,
+    NT_FUNCTION_DEFINITION,
+    NT_DECLARATION,
+    NT_DECLARATION_SPECIFIERS,
+    NT_DECLARATOR,
+    NT_DECLARATION_LIST,
+    NT_COMPOUND_STATEMENT,
+    NT_INIT_DECLARATOR_LIST,
+    NT_STORAGE_CLASS_SPECIFIER,
+    NT_TYPE_SPECIFIER,
+    NT_TYPE_QUALIFIER,
+    NT_STRUCT_OR_UNION_SPECIFIER,
+    NT_ENUM_SPECIFIER,
+    NT_TYPEDEF_NAME,
+    NT_STRUCT_OR_UNION,
+    NT_STRUCT_DECLARATION_LIST,
+    NT_STRUCT_DECLARATION,
+    NT_INIT_DECLARATOR,
+    NT_INITIALIZER,
+    NT_SPECIFIER_QUALIFIER_LIST,
+    NT_STRUCT_DECLARATOR_LIST,
+    NT_STRUCT_DECLARATOR,
+    NT_CONSTANT_EXPRESSION,
+    NT_ENUMERATOR_LIST,
+    NT_ENUMERATOR,
+    NT_POINTER,
+    NT_DIRECT_DECLARATOR,
+    NT_PARAMETER_TYPE_LIST,
+    NT_IDENTIFIER_LIST,
+    NT_TYPE_QUALIFIER_LIST,
+    NT_PARAMETER_LIST,
+    NT_PARAMETER_DECLARATION,
+    NT_ABSTRACT_DECLARATOR,
+    NT_ASSIGNMENT_EXPRESSION,
+    NT_INITIALIZER_LIST,
+    NT_TYPE_NAME,
+    NT_DIRECT_ABSTRACT_DECLARATOR,
+    NT_STATEMENT,
+    NT_LABELED_STATEMENT,
+    NT_EXPRESSION_STATEMENT,
+    NT_SELECTION_STATEMENT,
+    NT_ITERATION_STATEMENT,
+    NT_JUMP_STATEMENT,
+    NT_EXPRESSION,
+    NT_STATEMENT_LIST,
+    NT_CONDITIONAL_EXPRESSION,
+    NT_UNARY_EXPRESSION,
+    NT_ASSIGNMENT_OPERATOR,
+    NT_LOGICAL_OR_EXPRESSION,
+    NT_LOGICAL_AND_EXPRESSION,
+    NT_INCLUSIVE_OR_EXPRESSION,
+    NT_EXCLUSIVE_OR_EXPRESSION,
+    NT_AND_EXPRESSION,
+    NT_EQUALITY_EXPRESSION,
+    NT_RELATIONAL_EXPRESSION,
+    NT_SHIFT_EXPRESSION,
+    NT_ADDITIVE_EXPRESSION,
+    NT_MULTIPLICATIVE_EXPRESSION,
+    NT_CAST_EXPRESSION,
+    NT_POSTFIX_EXPRESSION,
+    NT_UNARY_OPERATOR,
+    NT_PRIMARY_EXPRESSION,
+    NT_ARGUMENT_EXPRESSION_LIST,
+    NT_CONSTANT,
+    NT_COUNT
+};
+
+#define TOKEN_SET_WORDS 2
+
+/* token t is bit t % 32 of word t / 32 */
+static const struct {
+    unsigned first[TOKEN_SET_WORDS];
+    unsigned follow[TOKEN_SET_WORDS];
+} s_grammar[NT_COUNT] = {
+    /* translation_unit */
+    /* first: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_LPAR TK_STAR */
+    /* follow: TK_EOF TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_LPAR
+       TK_STAR */
+    { { 0x0011007a, 0x00000000 }, { 0x0011007b, 0x00000000 } },
+    /* external_declaration */
+    /* first: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_LPAR TK_STAR */
+    /* follow: TK_EOF TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_LPAR
+       TK_STAR */
+    { { 0x0011007a, 0x00000000 }, { 0x0011007b, 0x00000000 } },
+    /* function_definition */
+    /* first: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_LPAR TK_STAR */
+    /* follow: TK_EOF TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_LPAR
+       TK_STAR */
+    { { 0x0011007a, 0x00000000 }, { 0x0011007b, 0x00000000 } },
+    /* declaration */
+    /* first: TK_STATIC TK_EXTERN TK_VOID TK_INT */
+    /* follow: TK_EOF TK_ID TK_INT_LIT TK_STATIC TK_EXTERN TK_VOID TK_INT
+       TK_IF TK_WHILE TK_FOR TK_CONTINUE TK_BREAK TK_RETURN TK_SEMI TK_LPAR
+       TK_BEGIN TK_END TK_STAR TK_PLUS TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00000078, 0x00000000 }, { 0x00ddbeff, 0x00000026 } },
+    /* declaration_specifiers */
+    /* first: TK_STATIC TK_EXTERN TK_VOID TK_INT */
+    /* follow: TK_ID TK_COMMA TK_SEMI TK_LPAR TK_RPAR TK_STAR */
+    { { 0x00000078, 0x00000000 }, { 0x0013c002, 0x00000000 } },
+    /* declarator */
+    /* first: TK_ID TK_LPAR TK_STAR */
+    /* follow: TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI TK_RPAR
+       TK_BEGIN TK_ASSIGN TK_COLON */
+    { { 0x00110002, 0x00000000 }, { 0x0106c078, 0x00000400 } },
+    /* declaration_list */
+    /* first: TK_STATIC TK_EXTERN TK_VOID TK_INT */
+    /* follow: TK_ID TK_INT_LIT TK_STATIC TK_EXTERN TK_VOID TK_INT TK_IF
+       TK_WHILE TK_FOR TK_CONTINUE TK_BREAK TK_RETURN TK_SEMI TK_LPAR
+       TK_BEGIN TK_END TK_STAR TK_PLUS TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00000078, 0x00000000 }, { 0x00ddbefe, 0x00000026 } },
+    /* compound_statement */
+    /* first: TK_BEGIN */
+    /* follow: TK_EOF TK_ID TK_INT_LIT TK_STATIC TK_EXTERN TK_VOID TK_INT
+       TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE TK_BREAK TK_RETURN TK_SEMI
+       TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS TK_MINUS TK_AND TK_NOT
+       TK_TILDE */
+    { { 0x00040000, 0x00000000 }, { 0x00ddbfff, 0x00000026 } },
+    /* init_declarator_list */
+    /* first: TK_ID TK_LPAR TK_STAR */
+    /* follow: TK_COMMA TK_SEMI */
+    { { 0x00110002, 0x00000000 }, { 0x0000c000, 0x00000000 } },
+    /* storage_class_specifier */
+    /* first: TK_STATIC TK_EXTERN */
+    /* follow: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI
+       TK_LPAR TK_RPAR TK_STAR */
+    { { 0x00000018, 0x00000000 }, { 0x0013c07a, 0x00000000 } },
+    /* type_specifier */
+    /* first: TK_VOID TK_INT */
+    /* follow: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI
+       TK_LPAR TK_RPAR TK_STAR TK_COLON */
+    { { 0x00000060, 0x00000000 }, { 0x0013c07a, 0x00000400 } },
+    /* type_qualifier */
+    /* first: */
+    /* follow: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI
+       TK_LPAR TK_RPAR TK_STAR TK_COLON */
+    { { 0x00000000, 0x00000000 }, { 0x0013c07a, 0x00000400 } },
+    /* struct_or_union_specifier */
+    /* first: */
+    /* follow: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI
+       TK_LPAR TK_RPAR TK_STAR TK_COLON */
+    { { 0x00000000, 0x00000000 }, { 0x0013c07a, 0x00000400 } },
+    /* enum_specifier */
+    /* first: */
+    /* follow: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI
+       TK_LPAR TK_RPAR TK_STAR TK_COLON */
+    { { 0x00000000, 0x00000000 }, { 0x0013c07a, 0x00000400 } },
+    /* typedef_name */
+    /* first: */
+    /* follow: TK_ID TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI
+       TK_LPAR TK_RPAR TK_STAR TK_COLON */
+    { { 0x00000000, 0x00000000 }, { 0x0013c07a, 0x00000400 } },
+    /* struct_or_union */
+    /* first: */
+    /* follow: TK_ID TK_BEGIN */
+    { { 0x00000000, 0x00000000 }, { 0x00040002, 0x00000000 } },
+    /* struct_declaration_list */
+    /* first: TK_VOID TK_INT */
+    /* follow: TK_VOID TK_INT TK_END */
+    { { 0x00000060, 0x00000000 }, { 0x00080060, 0x00000000 } },
+    /* struct_declaration */
+    /* first: TK_VOID TK_INT */
+    /* follow: TK_VOID TK_INT TK_END */
+    { { 0x00000060, 0x00000000 }, { 0x00080060, 0x00000000 } },
+    /* init_declarator */
+    /* first: TK_ID TK_LPAR TK_STAR */
+    /* follow: TK_COMMA TK_SEMI */
+    { { 0x00110002, 0x00000000 }, { 0x0000c000, 0x00000000 } },
+    /* initializer */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_BEGIN TK_STAR TK_PLUS TK_MINUS
+       TK_AND TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_END */
+    { { 0x00d50006, 0x00000026 }, { 0x0008c000, 0x00000000 } },
+    /* specifier_qualifier_list */
+    /* first: TK_VOID TK_INT */
+    /* follow: TK_ID TK_LPAR TK_RPAR TK_STAR TK_COLON */
+    { { 0x00000060, 0x00000000 }, { 0x00130002, 0x00000400 } },
+    /* struct_declarator_list */
+    /* first: TK_ID TK_LPAR TK_STAR TK_COLON */
+    /* follow: TK_COMMA TK_SEMI */
+    { { 0x00110002, 0x00000400 }, { 0x0000c000, 0x00000000 } },
+    /* struct_declarator */
+    /* first: TK_ID TK_LPAR TK_STAR TK_COLON */
+    /* follow: TK_COMMA TK_SEMI */
+    { { 0x00110002, 0x00000400 }, { 0x0000c000, 0x00000000 } },
+    /* constant_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_END TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x0008c000, 0x00000400 } },
+    /* enumerator_list */
+    /* first: TK_ID */
+    /* follow: TK_COMMA TK_END */
+    { { 0x00000002, 0x00000000 }, { 0x00084000, 0x00000000 } },
+    /* enumerator */
+    /* first: TK_ID */
+    /* follow: TK_COMMA TK_END */
+    { { 0x00000002, 0x00000000 }, { 0x00084000, 0x00000000 } },
+    /* pointer */
+    /* first: TK_STAR */
+    /* follow: TK_ID TK_COMMA TK_LPAR TK_RPAR */
+    { { 0x00100000, 0x00000000 }, { 0x00034002, 0x00000000 } },
+    /* direct_declarator */
+    /* first: TK_ID TK_LPAR */
+    /* follow: TK_STATIC TK_EXTERN TK_VOID TK_INT TK_COMMA TK_SEMI TK_LPAR
+       TK_RPAR TK_BEGIN TK_ASSIGN TK_COLON */
+    { { 0x00010002, 0x00000000 }, { 0x0107c078, 0x00000400 } },
+    /* parameter_type_list */
+    /* first: TK_STATIC TK_EXTERN TK_VOID TK_INT */
+    /* follow: TK_RPAR */
+    { { 0x00000078, 0x00000000 }, { 0x00020000, 0x00000000 } },
+    /* identifier_list */
+    /* first: TK_ID */
+    /* follow: TK_COMMA TK_RPAR */
+    { { 0x00000002, 0x00000000 }, { 0x00024000, 0x00000000 } },
+    /* type_qualifier_list */
+    /* first: */
+    /* follow: TK_ID TK_COMMA TK_LPAR TK_RPAR TK_STAR */
+    { { 0x00000000, 0x00000000 }, { 0x00134002, 0x00000000 } },
+    /* parameter_list */
+    /* first: TK_STATIC TK_EXTERN TK_VOID TK_INT */
+    /* follow: TK_COMMA TK_RPAR */
+    { { 0x00000078, 0x00000000 }, { 0x00024000, 0x00000000 } },
+    /* parameter_declaration */
+    /* first: TK_STATIC TK_EXTERN TK_VOID TK_INT */
+    /* follow: TK_COMMA TK_RPAR */
+    { { 0x00000078, 0x00000000 }, { 0x00024000, 0x00000000 } },
+    /* abstract_declarator */
+    /* first: TK_LPAR TK_STAR */
+    /* follow: TK_COMMA TK_RPAR */
+    { { 0x00110000, 0x00000000 }, { 0x00024000, 0x00000000 } },
+    /* assignment_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x000ac000, 0x00000400 } },
+    /* initializer_list */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_BEGIN TK_STAR TK_PLUS TK_MINUS
+       TK_AND TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_END */
+    { { 0x00d50006, 0x00000026 }, { 0x00084000, 0x00000000 } },
+    /* type_name */
+    /* first: TK_VOID TK_INT */
+    /* follow: TK_RPAR */
+    { { 0x00000060, 0x00000000 }, { 0x00020000, 0x00000000 } },
+    /* direct_abstract_declarator */
+    /* first: TK_LPAR */
+    /* follow: TK_COMMA TK_LPAR TK_RPAR */
+    { { 0x00010000, 0x00000000 }, { 0x00034000, 0x00000000 } },
+    /* statement */
+    /* first: TK_ID TK_INT_LIT TK_IF TK_WHILE TK_FOR TK_CONTINUE TK_BREAK
+       TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE
+       TK_BREAK TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS
+       TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00d5be86, 0x00000026 }, { 0x00ddbf86, 0x00000026 } },
+    /* labeled_statement */
+    /* first: TK_ID */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE
+       TK_BREAK TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS
+       TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00000002, 0x00000000 }, { 0x00ddbf86, 0x00000026 } },
+    /* expression_statement */
+    /* first: TK_ID TK_INT_LIT TK_SEMI TK_LPAR TK_STAR TK_PLUS TK_MINUS
+       TK_AND TK_NOT TK_TILDE */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE
+       TK_BREAK TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS
+       TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00d18006, 0x00000026 }, { 0x00ddbf86, 0x00000026 } },
+    /* selection_statement */
+    /* first: TK_IF */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE
+       TK_BREAK TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS
+       TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00000080, 0x00000000 }, { 0x00ddbf86, 0x00000026 } },
+    /* iteration_statement */
+    /* first: TK_WHILE TK_FOR */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE
+       TK_BREAK TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS
+       TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00000600, 0x00000000 }, { 0x00ddbf86, 0x00000026 } },
+    /* jump_statement */
+    /* first: TK_CONTINUE TK_BREAK TK_RETURN */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_ELSE TK_WHILE TK_FOR TK_CONTINUE
+       TK_BREAK TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS
+       TK_MINUS TK_AND TK_NOT TK_TILDE */
+    { { 0x00003800, 0x00000000 }, { 0x00ddbf86, 0x00000026 } },
+    /* expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x0002c000, 0x00000400 } },
+    /* statement_list */
+    /* first: TK_ID TK_INT_LIT TK_IF TK_WHILE TK_FOR TK_CONTINUE TK_BREAK
+       TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_ID TK_INT_LIT TK_IF TK_WHILE TK_FOR TK_CONTINUE TK_BREAK
+       TK_RETURN TK_SEMI TK_LPAR TK_BEGIN TK_END TK_STAR TK_PLUS TK_MINUS
+       TK_AND TK_NOT TK_TILDE */
+    { { 0x00d5be86, 0x00000026 }, { 0x00ddbe86, 0x00000026 } },
+    /* conditional_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x000ac000, 0x00000400 } },
+    /* unary_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_STAR TK_SLASH TK_PLUS
+       TK_MINUS TK_ASSIGN TK_LOR TK_LAND TK_EQ TK_NEQ TK_LT TK_GT TK_LE
+       TK_GE TK_AND TK_OR TK_XOR TK_PERCENT TK_SHL TK_SHR TK_QUESTION
+       TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0xfffac000, 0x000007db } },
+    /* assignment_operator */
+    /* first: TK_ASSIGN */
+    /* follow: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    { { 0x01000000, 0x00000000 }, { 0x00d10006, 0x00000026 } },
+    /* logical_or_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x020ac000, 0x00000600 } },
+    /* logical_and_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_QUESTION
+       TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x060ac000, 0x00000600 } },
+    /* inclusive_or_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_OR
+       TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x060ac000, 0x00000608 } },
+    /* exclusive_or_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_OR TK_XOR
+       TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x060ac000, 0x00000618 } },
+    /* and_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_AND TK_OR
+       TK_XOR TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x060ac000, 0x0000061a } },
+    /* equality_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_EQ TK_NEQ
+       TK_AND TK_OR TK_XOR TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0x1e0ac000, 0x0000061a } },
+    /* relational_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_EQ TK_NEQ
+       TK_LT TK_GT TK_LE TK_GE TK_AND TK_OR TK_XOR TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0xfe0ac000, 0x0000061b } },
+    /* shift_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_LOR TK_LAND TK_EQ TK_NEQ
+       TK_LT TK_GT TK_LE TK_GE TK_AND TK_OR TK_XOR TK_SHL TK_SHR TK_QUESTION
+       TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0xfe0ac000, 0x0000079b } },
+    /* additive_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_PLUS TK_MINUS TK_LOR
+       TK_LAND TK_EQ TK_NEQ TK_LT TK_GT TK_LE TK_GE TK_AND TK_OR TK_XOR
+       TK_SHL TK_SHR TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0xfecac000, 0x0000079b } },
+    /* multiplicative_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_STAR TK_SLASH TK_PLUS
+       TK_MINUS TK_LOR TK_LAND TK_EQ TK_NEQ TK_LT TK_GT TK_LE TK_GE TK_AND
+       TK_OR TK_XOR TK_PERCENT TK_SHL TK_SHR TK_QUESTION TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0xfefac000, 0x000007db } },
+    /* cast_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_SEMI TK_RPAR TK_END TK_STAR TK_SLASH TK_PLUS
+       TK_MINUS TK_ASSIGN TK_LOR TK_LAND TK_EQ TK_NEQ TK_LT TK_GT TK_LE
+       TK_GE TK_AND TK_OR TK_XOR TK_PERCENT TK_SHL TK_SHR TK_QUESTION
+       TK_COLON */
+    { { 0x00d10006, 0x00000026 }, { 0xfffac000, 0x000007db } },
+    /* postfix_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR */
+    /* follow: TK_COMMA TK_SEMI TK_LPAR TK_RPAR TK_END TK_STAR TK_SLASH
+       TK_PLUS TK_MINUS TK_ASSIGN TK_LOR TK_LAND TK_EQ TK_NEQ TK_LT TK_GT
+       TK_LE TK_GE TK_AND TK_OR TK_XOR TK_PERCENT TK_SHL TK_SHR TK_QUESTION
+       TK_COLON */
+    { { 0x00010006, 0x00000000 }, { 0xfffbc000, 0x000007db } },
+    /* unary_operator */
+    /* first: TK_STAR TK_PLUS TK_MINUS TK_AND TK_NOT TK_TILDE */
+    /* follow: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    { { 0x00d00000, 0x00000026 }, { 0x00d10006, 0x00000026 } },
+    /* primary_expression */
+    /* first: TK_ID TK_INT_LIT TK_LPAR */
+    /* follow: TK_COMMA TK_SEMI TK_LPAR TK_RPAR TK_END TK_STAR TK_SLASH
+       TK_PLUS TK_MINUS TK_ASSIGN TK_LOR TK_LAND TK_EQ TK_NEQ TK_LT TK_GT
+       TK_LE TK_GE TK_AND TK_OR TK_XOR TK_PERCENT TK_SHL TK_SHR TK_QUESTION
+       TK_COLON */
+    { { 0x00010006, 0x00000000 }, { 0xfffbc000, 0x000007db } },
+    /* argument_expression_list */
+    /* first: TK_ID TK_INT_LIT TK_LPAR TK_STAR TK_PLUS TK_MINUS TK_AND
+       TK_NOT TK_TILDE */
+    /* follow: TK_COMMA TK_RPAR */
+    { { 0x00d10006, 0x00000026 }, { 0x00024000, 0x00000000 } },
+    /* constant */
+    /* first: TK_INT_LIT */
+    /* follow: TK_COMMA TK_SEMI TK_LPAR TK_RPAR TK_END TK_STAR TK_SLASH
+       TK_PLUS TK_MINUS TK_ASSIGN TK_LOR TK_LAND TK_EQ TK_NEQ TK_LT TK_GT
+       TK_LE TK_GE TK_AND TK_OR TK_XOR TK_PERCENT TK_SHL TK_SHR TK_QUESTION
+       TK_COLON */
+    { { 0x00000004, 0x00000000 }, { 0xfffbc000, 0x000007db } },
+};
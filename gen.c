@@ -1,11 +1,9 @@
 #include <assert.h>
 #include "mcc.h"
 
-static int s_label_number = 0;
-
-int new_label(void)
+int new_label(COMPILER *cc)
 {
-    return s_label_number++;
+    return cc->label_number++;
 }
 
 void gen_header(FILE *fp)
@@ -13,91 +11,170 @@ void gen_header(FILE *fp)
     fprintf(fp, ".intel_syntax noprefix\n");
 }
 
-void gen_lval(FILE *fp, const NODE *np)
+void gen_lval(COMPILER *cc, FILE *fp, const AST *ast, AST_NODE n)
 {
-    assert(np->kind == NK_ID);
-    if (np->kind != NK_ID)
-        error(&np->pos, "invalid left value (not variable)");
-    assert(np->u.sym);
+    const SYMBOL *sym;
+
+    assert(ast_kind(ast, n) == NK_ID);
+    if (ast_kind(ast, n) != NK_ID)
+        error(cc, ast_loc(ast, n), "invalid left value (not variable)");
+    sym = ast_sym(ast, n);
+    assert(sym);
     fprintf(fp, "    mov rax, rbp\n");
-    fprintf(fp, "    sub rax, %d   ; %s\n", np->u.sym->var_num * 8,
-                    np->u.sym->id);
+    fprintf(fp, "    sub rax, %d   ; %s\n", sym->var_num * 8, sym->id);
     fprintf(fp, "    push rax\n");
 }
 
-bool compile_node(FILE *fp, const NODE *np)
+/* arithmetic and comparisons, which leave their value on the stack */
+static bool is_binary(NODE_KIND kind)
+{
+    switch (kind) {
+    case NK_ADD:
+    case NK_SUB:
+    case NK_MUL:
+    case NK_DIV:
+    case NK_EQ:
+    case NK_NEQ:
+    case NK_LT:
+    case NK_GT:
+    case NK_LE:
+    case NK_GE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* the left operand in rax, the right one in rdi */
+static void gen_binary(FILE *fp, NODE_KIND kind)
+{
+    switch (kind) {
+    case NK_ADD:
+        fprintf(fp, "    add rax, rdi\n");
+        break;
+    case NK_SUB:
+        fprintf(fp, "    sub rax, rdi\n");
+        break;
+    case NK_MUL:
+        fprintf(fp, "    imul rax, rdi\n");
+        break;
+    case NK_DIV:
+        fprintf(fp, "    cqo\n");
+        fprintf(fp, "    idiv rdi\n");
+        break;
+    case NK_EQ:
+        fprintf(fp, "    cmp rax, rdi\n");
+        fprintf(fp, "    sete al\n");
+        fprintf(fp, "    movzb rax, al\n");
+        break;
+    case NK_NEQ:
+        fprintf(fp, "    cmp rax, rdi\n");
+        fprintf(fp, "    setne al\n");
+        fprintf(fp, "    movzb rax, al\n");
+        break;
+    case NK_LT:
+        fprintf(fp, "    cmp rax, rdi\n");
+        fprintf(fp, "    setl al\n");
+        fprintf(fp, "    movzb rax, al\n");
+        break;
+    case NK_GT:
+        fprintf(fp, "    cmp rax, rdi\n");
+        fprintf(fp, "    setg al\n");
+        fprintf(fp, "    movzb rax, al\n");
+        break;
+    case NK_LE:
+        fprintf(fp, "    cmp rax, rdi\n");
+        fprintf(fp, "    setle al\n");
+        fprintf(fp, "    movzb rax, al\n");
+        break;
+    case NK_GE:
+        fprintf(fp, "    cmp rax, rdi\n");
+        fprintf(fp, "    setge al\n");
+        fprintf(fp, "    movzb rax, al\n");
+        break;
+    default: assert(0);
+    }
+}
+
+bool compile_node(COMPILER *cc, FILE *fp, const AST *ast, AST_NODE n)
 {
     int label1, label2;
+    unsigned i;
+    AST_NODE m, inner;
+    SRCLOC loc;
 
-    if (np == NULL) {
+    if (n == 0) {
         return true;
     }
 
-    switch (np->kind) {
-    case NK_LINK:
-        compile_node(fp, np->u.comp.left);
-        compile_node(fp, np->u.comp.right);
-        break;
+    loc = ast_loc(ast, n);
+    switch (ast_kind(ast, n)) {
     case NK_COMPOUND:
-        fprintf(fp, "; %s(%d)\n", np->pos.filename, np->pos.line);
-        compile_node(fp, np->u.comp.left);
+        fprintf(fp, "; %s(%d)\n", loc_filename(cc, loc), loc_line(cc, loc));
+        for (i = 0; i < ast_count(ast, n); i++)
+            compile_node(cc, fp, ast, ast_child(ast, n, i));
         break;
     case NK_IF:
-        fprintf(fp, "; %s(%d) IF\n", np->pos.filename, np->pos.line);
-        compile_node(fp, np->u.link.n1);
+        fprintf(fp, "; %s(%d) IF\n", loc_filename(cc, loc), loc_line(cc, loc));
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
         fprintf(fp, "    pop rax\n");
         fprintf(fp, "    cmp rax, 0\n");
-        label1 = new_label();
+        label1 = new_label(cc);
         fprintf(fp, "    je .L%d\n", label1);
-        compile_node(fp, np->u.link.n2);
-        label2 = new_label();
+        compile_node(cc, fp, ast, ast_child(ast, n, 1));
+        label2 = new_label(cc);
         fprintf(fp, "    jmp .L%d\n", label2);
-        if (np->u.link.n3) {
+        if (ast_child(ast, n, 2)) {
             fprintf(fp, ".L%d:\n", label1);
-            compile_node(fp, np->u.link.n3);
+            compile_node(cc, fp, ast, ast_child(ast, n, 2));
         }
         fprintf(fp, ".L%d:\n", label2);
         break;
     case NK_WHILE:
-        fprintf(fp, "; %s(%d) WHILE\n", np->pos.filename, np->pos.line);
-        label1 = new_label();
+        fprintf(fp, "; %s(%d) WHILE\n",
+                loc_filename(cc, loc), loc_line(cc, loc));
+        label1 = new_label(cc);
         fprintf(fp, ".L%d:\n", label1);
-        compile_node(fp, np->u.link.n1);
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
         fprintf(fp, "    pop rax\n");
         fprintf(fp, "    cmp rax, 0\n");
-        label2 = new_label();
+        label2 = new_label(cc);
         fprintf(fp, "    je .L%d\n", label2);
-        compile_node(fp, np->u.link.n2);
+        compile_node(cc, fp, ast, ast_child(ast, n, 1));
         fprintf(fp, "    jmp .L%d\n", label1);
         fprintf(fp, ".L%d:\n", label2);
         break;
     case NK_FOR:
-        fprintf(fp, "; %s(%d) FOR\n", np->pos.filename, np->pos.line);
-        compile_node(fp, np->u.link.n1);
-        label1 = new_label();
+        fprintf(fp, "; %s(%d) FOR\n",
+                loc_filename(cc, loc), loc_line(cc, loc));
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
+        label1 = new_label(cc);
         fprintf(fp, ".L%d:\n", label1);
-        compile_node(fp, np->u.link.n2);
+        compile_node(cc, fp, ast, ast_child(ast, n, 1));
         fprintf(fp, "    pop rax\n");
         fprintf(fp, "    cmp rax, 0\n");
-        label2 = new_label();
+        label2 = new_label(cc);
         fprintf(fp, "    je .L%d\n", label2);
-        compile_node(fp, np->u.link.n4);
-        compile_node(fp, np->u.link.n3);
+        compile_node(cc, fp, ast, ast_child(ast, n, 3));
+        compile_node(cc, fp, ast, ast_child(ast, n, 2));
         fprintf(fp, "    jmp .L%d\n", label1);
         fprintf(fp, ".L%d:\n", label2);
         break;
     case NK_CONTINUE:
-        fprintf(fp, "; %s(%d) CONTINUE\n", np->pos.filename, np->pos.line);
+        fprintf(fp, "; %s(%d) CONTINUE\n",
+                loc_filename(cc, loc), loc_line(cc, loc));
         /*TODO*/
         break;
     case NK_BREAK:
-        fprintf(fp, "; %s(%d) BREAK\n", np->pos.filename, np->pos.line);
+        fprintf(fp, "; %s(%d) BREAK\n",
+                loc_filename(cc, loc), loc_line(cc, loc));
         /*TODO*/
         break;
     case NK_RETURN:
-        fprintf(fp, "; %s(%d) RETURN\n", np->pos.filename, np->pos.line);
-        if (np->u.link.n1) {
-            compile_node(fp, np->u.link.n1);
+        fprintf(fp, "; %s(%d) RETURN\n",
+                loc_filename(cc, loc), loc_line(cc, loc));
+        if (ast_child(ast, n, 0)) {
+            compile_node(cc, fp, ast, ast_child(ast, n, 0));
             fprintf(fp, "    pop rax\n");
             fprintf(fp, "    mov rsp, rbp\n");
             fprintf(fp, "    pop rbp\n");
@@ -105,9 +182,10 @@ bool compile_node(FILE *fp, const NODE *np)
         }
         break;
     case NK_EXPR:
-        fprintf(fp, "; %s(%d) EXPR ", np->pos.filename, np->pos.line);
-        fprint_node(fp, 0, np);
-        compile_node(fp, np->u.link.n1);
+        fprintf(fp, "; %s(%d) EXPR ",
+                loc_filename(cc, loc), loc_line(cc, loc));
+        fprint_ast(cc, fp, 0, ast, n);
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
         break;
     case NK_ADD:
     case NK_SUB:
@@ -119,61 +197,20 @@ bool compile_node(FILE *fp, const NODE *np)
     case NK_GT:
     case NK_LE:
     case NK_GE:
-        compile_node(fp, np->u.link.n1);
-        compile_node(fp, np->u.link.n2);
-        fprintf(fp, "    pop rdi\n");
-        fprintf(fp, "    pop rax\n");
-        switch (np->kind) {
-        case NK_ADD:
-            fprintf(fp, "    add rax, rdi\n");
-            break;
-        case NK_SUB:
-            fprintf(fp, "    sub rax, rdi\n");
-            break;
-        case NK_MUL:
-            fprintf(fp, "    imul rax, rdi\n");
-            break;
-        case NK_DIV:
-            fprintf(fp, "    cqo\n");
-            fprintf(fp, "    idiv rdi\n");
-            break;
-        case NK_EQ:
-            fprintf(fp, "    cmp rax, rdi\n");
-            fprintf(fp, "    sete al\n");
-            fprintf(fp, "    movzb rax, al\n");
-            break;
-        case NK_NEQ:
-            fprintf(fp, "    cmp rax, rdi\n");
-            fprintf(fp, "    setne al\n");
-            fprintf(fp, "    movzb rax, al\n");
-            break;
-        case NK_LT:
-            fprintf(fp, "    cmp rax, rdi\n");
-            fprintf(fp, "    setl al\n");
-            fprintf(fp, "    movzb rax, al\n");
-            break;
-        case NK_GT:
-            fprintf(fp, "    cmp rax, rdi\n");
-            fprintf(fp, "    setg al\n");
-            fprintf(fp, "    movzb rax, al\n");
-            break;
-        case NK_LE:
-            fprintf(fp, "    cmp rax, rdi\n");
-            fprintf(fp, "    setle al\n");
-            fprintf(fp, "    movzb rax, al\n");
-            break;
-        case NK_GE:
-            fprintf(fp, "    cmp rax, rdi\n");
-            fprintf(fp, "    setge al\n");
-            fprintf(fp, "    movzb rax, al\n");
-            break;
-        default: assert(0);
+        /* a chain of left operands, from the innermost up */
+        inner = ast_chain(ast, n, is_binary);
+        compile_node(cc, fp, ast, inner);
+        for (m = inner; m-- > n; ) {
+            compile_node(cc, fp, ast, ast_child(ast, m, 1));
+            fprintf(fp, "    pop rdi\n");
+            fprintf(fp, "    pop rax\n");
+            gen_binary(fp, ast_kind(ast, m));
+            fprintf(fp, "    push rax\n");
         }
-        fprintf(fp, "    push rax\n");
         break;
     case NK_ASSIGN:
-        gen_lval(fp, np->u.link.n1);
-        compile_node(fp, np->u.link.n2);
+        gen_lval(cc, fp, ast, ast_child(ast, n, 0));
+        compile_node(cc, fp, ast, ast_child(ast, n, 1));
         fprintf(fp, "    pop rdi\n");
         fprintf(fp, "    pop rax\n");
         fprintf(fp, "    mov [rax], rdi\n");
@@ -185,9 +222,9 @@ bool compile_node(FILE *fp, const NODE *np)
         /*TODO*/
         /*
         fprintf(fp, "(");
-        compile_node(fp, np->u.link.n1);
-        fprintf(fp, " %s ", node_kind_to_str(np->kind));
-        compile_node(fp, np->u.link.n2);
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
+        fprintf(fp, " %s ", node_kind_to_str(ast_kind(ast, n)));
+        compile_node(cc, fp, ast, ast_child(ast, n, 1));
         fprintf(fp, ")");
         */
         break;
@@ -197,16 +234,16 @@ bool compile_node(FILE *fp, const NODE *np)
     case NK_NOT:
         /*TODO*/
         /*
-        fprintf(fp, "(%s", node_kind_to_str(np->kind));
-        compile_node(fp, np->u.link.n1);
+        fprintf(fp, "(%s", node_kind_to_str(ast_kind(ast, n)));
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
         fprintf(fp, ")");
         */
         break;
     case NK_ID:
-        assert(np->u.sym);
-        if (np->u.sym->kind == SK_VAR) {
-            if (np->u.sym->var_num != 0) {
-                gen_lval(fp, np);
+        assert(ast_sym(ast, n));
+        if (ast_sym(ast, n)->kind == SK_VAR) {
+            if (ast_sym(ast, n)->var_num != 0) {
+                gen_lval(cc, fp, ast, n);
                 fprintf(fp, "    pop rax\n");
                 fprintf(fp, "    mov rax, [rax]\n");
                 fprintf(fp, "    push rax\n");
@@ -214,39 +251,46 @@ bool compile_node(FILE *fp, const NODE *np)
                 /* TODO global var */
             }
         } else {
-            fprintf(fp, ";FUNC %s\n", np->u.sym->id);
+            fprintf(fp, ";FUNC %s\n", ast_sym(ast, n)->id);
             /*TODO*/
         }
         break;
     case NK_INT_LIT:
-        fprintf(fp, "    push %d\n", np->u.num);
+        fprintf(fp, "    push %d\n", ast_num(ast, n));
         break;
     case NK_CALL:
         /*TODO*/
         /*
-        compile_node(fp, np->u.link.n1);
+        compile_node(cc, fp, ast, ast_child(ast, n, 0));
         fprintf(fp, "(");
-        compile_node(fp, np->u.link.n2);
+        for (i = 1; i < ast_count(ast, n); i++) {
+            if (i > 1)
+                fprintf(fp, ", ");
+            compile_node(cc, fp, ast, ast_child(ast, n, i));
+        }
         fprintf(fp, ")");
         */
         break;
+    case NK_LINK:
     case NK_ARG:
-        /* TODO
-        compile_node(fp, np->u.link.n1);
-        if (np->u.link.n2) {
-            fprintf(fp, ", ");
-            compile_node(fp, np->u.link.n2);
-        }
-        */
+        assert(0);      /* not in an AST */
         break;
     }
 
     return true;
 }
 
-bool compile_symbol(FILE *fp, const SYMBOL *sym)
+/* a body skipped by the parser is parsed here, when it is needed */
+bool compile_symbol(COMPILER *cc, FILE *fp, SYMBOL *sym)
 {
+    if (sym->kind == SK_FUNC && cc->body_parser != NULL) {
+        int errors = get_error_count(cc);
+        if (!parse_body(cc->body_parser, sym)
+                || get_error_count(cc) != errors)
+            return false;
+    }
     if (sym->kind == SK_FUNC && sym->has_body) {
+        AST *ast;
         if (sym->sclass != SC_STATIC)
             fprintf(fp, ".global %s\n", sym->id);
         if (sym->sclass != SC_EXTERN)
@@ -256,7 +300,10 @@ bool compile_symbol(FILE *fp, const SYMBOL *sym)
             fprintf(fp, "    mov rbp, rsp\n");
             if (sym->var_num > 0)
                 fprintf(fp, "    sub rbp, %d\n", sym->var_num * 8);
-            if (!compile_node(fp, sym->body_node))
+            ast = new_ast(sym->arena, sym->body_node);
+            if (is_debug(DEBUG_AST))
+                print_ast_stats(sym->id, ast);
+            if (!compile_node(cc, fp, ast, ast_root(ast)))
                 return false;
             fprintf(fp, "    mov rsp, rbp\n");
             fprintf(fp, "    pop rbp\n");
@@ -1,7 +1,18 @@
 #include <string.h>
+#include <pthread.h>
 #include "mcc.h"
 
 #define MAX_PATH    256
+#define MAX_JOBS    256
+
+static bool s_token_stream = false;
+static const char *s_pch_file = NULL;
+static int s_error_limit = -1;         /* -1: the default */
+static int s_jobs = 1;
+static bool s_lazy_bodies = false;     /* parsed when compiled */
+static bool s_bodies_first = false;    /* all of them, before codegen */
+static bool s_decls_only = false;
+static bool s_file_headers = false;    /* name each file's listing */
 
 static void change_filename_ext(char *name, const char *orig, const char *ext)
 {
@@ -11,71 +22,241 @@ static void change_filename_ext(char *name, const char *orig, const char *ext)
     if (p)
         strcpy(p, ext);
     else
-        strcat(p, ext);
+        strcat(name, ext);
 }
 
-static int compile_file(const char *filename)
+/*
+ * with -flazy-bodies the parser is kept open while the code is made,
+ * and each body is parsed as its function is compiled.  all the bodies
+ * are parsed first with -fbody-threads, or to tell all the errors of a
+ * file that has some.
+ */
+static int compile_file_1(COMPILER *cc, const char *filename)
 {
     char asm_name[MAX_PATH+1];
     PARSER *pars;
+    FILE *volatile fp = NULL;
     int result;
 
-    pars = open_parser(filename);
+    pars = open_parser(cc, filename);
     if (pars == NULL) {
         fprintf(stderr, "can't open '%s'\n", filename);
         return 1;
     }
-    if (setjmp(g_error_jmp_buf) != 0) {
+    if (setjmp(cc->error_jmp_buf) != 0) {
+        if (fp != NULL) {
+            fclose(fp);
+            change_filename_ext(asm_name, filename, ".s");
+            remove(asm_name);
+        }
         close_parser(pars);
+        flush_diagnostics(cc);
         return 1;
     }
+    if (s_pch_file != NULL)
+        use_pch(pars, s_pch_file);
+    if (s_token_stream)
+        prelex(pars);
+    if (s_lazy_bodies || s_decls_only)
+        skip_bodies(pars);
     result = parse(pars) ? 0 : 1;
-    close_parser(pars);
-    
-    if (is_debug("symbol"))
-        print_global_symtab();
+    if (s_decls_only) {
+        close_parser(pars);
+        flush_diagnostics(cc);
+        if (s_file_headers)
+            fprintf(cc->diag_fp, "%s:\n", filename);
+        fprint_global_symtab(cc, cc->diag_fp);
+        return result;
+    }
+    if (s_lazy_bodies && (s_bodies_first || result != 0
+                          || is_debug(DEBUG_SYMBOL))
+            && !parse_bodies(pars))
+        result = 1;
+    flush_diagnostics(cc);
+
+    if (is_debug(DEBUG_SYMBOL))
+        print_global_symtab(cc);
 
     if (result == 0) {
-        FILE *fp;
         change_filename_ext(asm_name, filename, ".s");
         fp = fopen(asm_name, "w");
         if (fp == NULL) {
             fprintf(stderr, "can't open '%s'\n", asm_name);
+            close_parser(pars);
             return 1;
         }
-        result = compile_all(fp) ? 0 : 1;
+        cc->body_parser = pars;
+        result = compile_all(cc, fp) ? 0 : 1;
+        cc->body_parser = NULL;
         fclose(fp);
+        fp = NULL;
+        if (result != 0) {
+            remove(asm_name);
+            if (s_lazy_bodies)
+                parse_bodies(pars);     /* the errors of the rest */
+        }
     }
+    close_parser(pars);
+    flush_diagnostics(cc);
+    return result;
+}
+
+/*
+ * each file gets a compiler of its own: identifiers, sources, symbols
+ * and diagnostics, all freed when it is done
+ */
+static int compile_file(const char *filename, FILE *diag_fp)
+{
+    COMPILER *cc = new_compiler();
+    int result;
+
+    cc->diag_fp = diag_fp;
+    if (s_error_limit >= 0)
+        set_error_limit(cc, s_error_limit);
+    init_symtab(cc);
+    result = compile_file_1(cc, filename);
+    if (is_debug(DEBUG_INTERN))
+        print_intern_stats(cc);
+    free_compiler(cc);
     return result;
 }
 
+/*
+ * -jN: the files are compiled on N threads, each taking the next file
+ * not started.  the diagnostics of a file are held in memory and written
+ * once the files before it are done, in the order of the command line.
+ */
+typedef struct {
+    const char *filename;
+    int result;
+    char *diag;
+    size_t diag_len;
+    bool done;
+} JOB;
+
+typedef struct {
+    JOB *job;
+    int n_job;
+    int next;               /* the next job to start */
+    pthread_mutex_t lock;
+    pthread_cond_t done;    /* a job is done */
+} POOL;
+
+static void *compile_thread(void *arg)
+{
+    POOL *pool = (POOL*) arg;
+    JOB *job;
+    FILE *fp;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        job = pool->next < pool->n_job ? &pool->job[pool->next++] : NULL;
+        pthread_mutex_unlock(&pool->lock);
+        if (job == NULL)
+            return NULL;
+        fp = open_memstream(&job->diag, &job->diag_len);
+        job->result = compile_file(job->filename, fp != NULL ? fp : stdout);
+        if (fp != NULL)
+            fclose(fp);
+        pthread_mutex_lock(&pool->lock);
+        job->done = true;
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* the number of files that failed */
+static int compile_files(const char **files, int n_file)
+{
+    pthread_t thread[MAX_JOBS];
+    bool started[MAX_JOBS];
+    int n_thread = s_jobs < n_file ? s_jobs : n_file;
+    POOL pool;
+    int i, n = 0;
+
+    if (n_thread <= 1) {
+        for (i = 0; i < n_file; i++)
+            n += compile_file(files[i], stdout);
+        return n;
+    }
+    pool.job = (JOB*) alloc(n_file * sizeof (JOB));
+    memset(pool.job, 0, n_file * sizeof (JOB));
+    for (i = 0; i < n_file; i++)
+        pool.job[i].filename = files[i];
+    pool.n_job = n_file;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    for (i = 0; i < n_thread; i++)
+        started[i] = pthread_create(&thread[i], NULL, compile_thread,
+                                    &pool) == 0;
+    if (!started[0])
+        compile_thread(&pool);      /* no threads: all of it here */
+
+    for (i = 0; i < n_file; i++) {
+        JOB *job = &pool.job[i];
+        pthread_mutex_lock(&pool.lock);
+        while (!job->done)
+            pthread_cond_wait(&pool.done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+        fwrite(job->diag, 1, job->diag_len, stdout);
+        free(job->diag);
+        n += job->result;
+    }
+    for (i = 0; i < n_thread; i++) {
+        if (started[i])
+            pthread_join(thread[i], NULL);
+    }
+    pthread_cond_destroy(&pool.done);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.job);
+    return n;
+}
+
 static void show_help(void)
 {
     printf("mcc - mini c compiler v" VERSION "\n");
-    printf("usage: mcc [-h][-dX] filename...\n");
+    printf("usage: mcc [-h][-jN][-dX][-fX][-Idir][-Dname[=value]] "
+            "filename...\n");
+    printf("  filename '-' reads standard input\n");
     printf("option\n");
     printf("  -h   help\n");
+    printf("  -jN  compile N files at a time\n");
     printf("  -dl  set scanner debug\n");
     printf("  -dp  set parser debug\n");
     printf("  -ds  set symbol debug\n");
+    printf("  -di  show identifier table statistics\n");
+    printf("  -da  show the size of each function's syntax tree\n");
+    printf("  -ftoken-stream  lex the whole file before parsing\n");
+    printf("  -flazy-bodies   parse function bodies as they are compiled\n");
+    printf("  -fdecls-only    print the global symbols, not parsing bodies\n");
+    printf("  -flex-threads=n lex the token stream on n threads\n");
+    printf("  -fbody-threads=n parse function bodies on n threads\n");
+    printf("  -fpch=file      keep the declarations of the headers in file\n");
+    printf("  -ferror-limit=n give up a file after n errors, 0: no limit\n");
+    printf("  -Idir           add dir to the #include search path\n");
+    printf("  -Dname[=value]  define a macro\n");
 }
 
 static int parse_command_line(int argc, char *argv[])
 {
     struct {
         char option;
-        char *debug;
+        DEBUG_CHANNEL debug;
     } options[] = {
-        { 'l', "scanner" },
-        { 'p', "parser" },
-        { 's', "symbol" },
+        { 'l', DEBUG_SCANNER },
+        { 'p', DEBUG_PARSER },
+        { 's', DEBUG_SYMBOL },
+        { 'i', DEBUG_INTERN },
+        { 'a', DEBUG_AST },
     };
     const int N_OPTIONS = sizeof (options) / sizeof (options[1]);
-    int i, j, n = 0;
+    const char **files = (const char**) alloc(argc * sizeof (char*));
+    int i, j, n;
     int n_file = 0;
 
     for (i = 1; i < argc; i++) {
-        if (argv[i][0] == '-') {
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
             switch (argv[i][1]) {
             case 'd':
                 for (j = 0; j < N_OPTIONS; j++) {
@@ -85,21 +266,73 @@ static int parse_command_line(int argc, char *argv[])
                     }
                 }
                 show_help();
+                free(files);
                 return 1;
+            case 'j':
+                s_jobs = atoi(argv[i] + 2);
+                if (s_jobs < 1 || s_jobs > MAX_JOBS) {
+                    show_help();
+                    free(files);
+                    return 1;
+                }
+                goto next;
+            case 'f':
+                if (strcmp(argv[i] + 2, "token-stream") == 0) {
+                    s_token_stream = true;
+                    goto next;
+                }
+                if (strcmp(argv[i] + 2, "lazy-bodies") == 0) {
+                    s_lazy_bodies = true;
+                    goto next;
+                }
+                if (strcmp(argv[i] + 2, "decls-only") == 0) {
+                    s_decls_only = true;
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "lex-threads=", 12) == 0) {
+                    set_lex_threads(atoi(argv[i] + 14));
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "body-threads=", 13) == 0) {
+                    set_body_threads(atoi(argv[i] + 15));
+                    s_lazy_bodies = true;
+                    s_bodies_first = true;
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "error-limit=", 12) == 0) {
+                    s_error_limit = atoi(argv[i] + 14);
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "pch=", 4) == 0) {
+                    s_pch_file = argv[i] + 6;
+                    goto next;
+                }
+                show_help();
+                free(files);
+                return 1;
+            case 'I':
+                add_include_dir(argv[i] + 2);
+                goto next;
+            case 'D':
+                add_predefine(argv[i] + 2);
+                goto next;
             default:
                 goto done;
             }
         } else {
-            n += compile_file(argv[i]);
-            n_file++;
+            files[n_file++] = argv[i];
         }
 next: ;
     }
 done:
     if (n_file == 0) {
         show_help();
+        free(files);
         return 1;
     }
+    s_file_headers = n_file > 1;
+    n = compile_files(files, n_file);
+    free(files);
     return n;
 }
 
@@ -107,9 +340,6 @@ int main(int argc, char *argv[])
 {
     int n;
 
-    init_symtab();
     n = parse_command_line(argc, argv);
-    term_symtab();
-
-    return n;
+    return n != 0;          /* a count of files would be taken mod 256 */
 }
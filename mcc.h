@@ -2,31 +2,141 @@
 #define mcc_h__
 
 #define VERSION     "0.0"
-#define MAX_IDENT   256
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <setjmp.h>
+#include <pthread.h>
 
 typedef int bool;
 #define true    1
 #define false   0
 
-extern jmp_buf g_error_jmp_buf;
+/* functions that do not return, but longjmp */
+#ifdef __GNUC__
+# define NORETURN   __attribute__((noreturn))
+#else
+# define NORETURN
+#endif
 
-bool is_debug(const char *s);
-void set_debug(const char *s);
+typedef enum {
+    DEBUG_SCANNER, DEBUG_PARSER, DEBUG_PARSER_SCOPE, DEBUG_SYMBOL,
+    DEBUG_NODE, DEBUG_INTERN, DEBUG_AST,
+} DEBUG_CHANNEL;
+
+/* build with -DMCC_NODEBUG to compile all debug channels out */
+#ifdef MCC_NODEBUG
+# define is_debug(ch)   false
+#else
+extern unsigned g_debug_mask;
+# ifdef __GNUC__
+#  define is_debug(ch)  __builtin_expect((g_debug_mask >> (ch)) & 1, 0)
+# else
+#  define is_debug(ch)  ((g_debug_mask >> (ch)) & 1)
+# endif
+#endif
+void set_debug(DEBUG_CHANNEL ch);
 void *alloc(size_t size);
 
+/* a place in the sources, see srcloc.c; 0: none */
+typedef unsigned SRCLOC;
+
+typedef struct arena ARENA;
+
+/*
+ * the state of one compile.  nothing else changes while a file is
+ * compiled, so each thread can compile with a context of its own.
+ */
+#define DIAG_BUFFER_SIZE    (16 * 1024)
+
+/* the end of an error in the diagnostics, and where it was */
+typedef struct {
+    long end;
+    SRCLOC loc;
+} ERROR_MARK;
+
+typedef struct compiler {
+    jmp_buf error_jmp_buf;      /* where a fatal error goes */
+    struct compiler *parent;    /* of a worker, see new_worker() */
+    /* misc.c */
+    int error_count;
+    int error_limit;            /* 0: no limit */
+    size_t diag_len;
+    char diag[DIAG_BUFFER_SIZE];    /* diagnostics not written yet */
+    FILE *diag_fp;              /* where they are written */
+    ERROR_MARK *error_mark;     /* error_limit of them, or NULL */
+    struct arena_block *free_blocks;
+    ARENA *arena;               /* new_object() takes from it */
+    /* srcloc.c */
+    struct source *source;
+    size_t n_source;
+    size_t source_size;
+    SRCLOC next_loc;
+    /* scanner.c */
+    struct ident *ident_table;
+    size_t ident_size;
+    size_t ident_count;
+    struct ident_chunk *ident_chunk;
+    char **ident_list;
+    size_t ident_list_size;
+    /* symbol.c */
+    struct symtab *global_table;
+    struct symtab *current_symtab;
+    struct symbol *current_function;
+    ARENA *file_arena;          /* globals and their types */
+    struct type **type_table;
+    size_t type_size;
+    size_t type_count;
+    pthread_mutex_t type_lock;  /* taken by its workers */
+    /* parser.c */
+    int indent;                 /* of the scope trace */
+    struct parser *body_parser; /* parses skipped bodies as compiled */
+    /* gen.c */
+    int label_number;
+} COMPILER;
+
+COMPILER *new_compiler(void);
+COMPILER *new_worker(COMPILER *cc);
+void free_compiler(COMPILER *cc);
+
+ARENA *new_arena(COMPILER *cc);
+void free_arena(ARENA *a);
+void move_arena(ARENA *a, COMPILER *cc);
+void *arena_alloc(ARENA *a, size_t size);
+void use_arena(COMPILER *cc, ARENA *a);
+ARENA *current_arena(COMPILER *cc);
+void *new_object(COMPILER *cc, size_t size);
+
 typedef struct {
     const char *filename;
     int line;
+    int column;
 } POS;
 
-void vwarning(const POS *pos, const char *s, va_list arg);
-void verror(const POS *pos, const char *s, va_list arg);
-void error(const POS *pos, const char *s, ...);
+void vwarning(COMPILER *cc, SRCLOC loc, const char *s, va_list arg);
+NORETURN void verror(COMPILER *cc, SRCLOC loc, const char *s, va_list arg);
+void warning(COMPILER *cc, SRCLOC loc, const char *s, ...);
+NORETURN void error(COMPILER *cc, SRCLOC loc, const char *s, ...);
+void vreport_error(COMPILER *cc, SRCLOC loc, const char *s, va_list arg);
+NORETURN void give_up(COMPILER *cc, SRCLOC loc);
+void set_error_limit(COMPILER *cc, int n);
+int get_error_count(COMPILER *cc);
+void clear_error_count(COMPILER *cc);
+void flush_diagnostics(COMPILER *cc);
+
+/* srcloc.c */
+SRCLOC add_source(COMPILER *cc, const char *filename, long long size,
+                  unsigned *range);
+void set_source_text(COMPILER *cc, SRCLOC base, const char *text,
+                     long long offset, size_t size);
+void drop_source_text(COMPILER *cc, SRCLOC base, long long end);
+SRCLOC source_loc(COMPILER *cc, SRCLOC base, long long offset);
+void free_sources(COMPILER *cc);
+void index_sources(COMPILER *cc);
+const char *loc_filename(COMPILER *cc, SRCLOC loc);
+int loc_line(COMPILER *cc, SRCLOC loc);
+POS decode_loc(COMPILER *cc, SRCLOC loc);
 
 typedef enum {
     T_UNKNOWN, T_VOID, T_NULL, T_INT, T_POINTER, T_FUNC
@@ -40,6 +150,7 @@ struct type {
     TYPE_KIND kind;
     TYPE *type;
     PARAM *param;
+    unsigned hash;
 };
 
 struct param {
@@ -51,8 +162,7 @@ struct param {
 extern TYPE g_type_int;
 extern TYPE g_type_null;
 
-TYPE *new_type(TYPE_KIND kind, TYPE *typ, PARAM *param);
-TYPE *dup_type(TYPE *typ);
+TYPE *new_type(COMPILER *cc, TYPE_KIND kind, TYPE *typ, PARAM *param);
 bool equal_type(const TYPE *tl, const TYPE *tr);
 bool type_is_void(const TYPE *typ);
 bool type_is_null(const TYPE *typ);
@@ -69,7 +179,7 @@ bool type_can_rel(const TYPE *lhs, const TYPE *rhs);
 bool type_can_logical(const TYPE *lhs, const TYPE *rhs);
 bool type_can_assign(const TYPE *lhs, const TYPE *rhs);
 bool type_warn_assign(const TYPE *lhs, const TYPE *rhs);
-PARAM *link_param(PARAM *top, TYPE *typ, char *id);
+PARAM *link_param(COMPILER *cc, PARAM *top, TYPE *typ, char *id);
 void fprint_type(FILE *fp, const TYPE *typ);
 void print_type(const TYPE *typ);
 
@@ -96,7 +206,9 @@ struct symbol {
     bool has_body;
     NODE *body_node;
     SYMTAB *tab;
+    ARENA *arena;           /* of the body, freed once it is compiled */
     int var_num;
+    size_t body_index;      /* 1 + its skipped body in the parser, or 0 */
 };
 
 struct symtab {
@@ -104,51 +216,125 @@ struct symtab {
     SYMTAB *up;
 };
 
-SYMBOL *new_symbol(SYMBOL_KIND kind, STORAGE_CLASS sc,
+SYMBOL *new_symbol(COMPILER *cc, SYMBOL_KIND kind, STORAGE_CLASS sc,
                     const char *id, TYPE *type, int var_num);
-SYMBOL *lookup_symbol_local(const char *id);
-SYMBOL *lookup_symbol(const char *id);
-SYMTAB *new_symtab(SYMTAB *up);
-SYMTAB *enter_scope(void);
-void leave_scope(void);
-SYMTAB *enter_function(SYMBOL *sym);
-void leave_function(void);
-int get_func_var_num(void);
-bool init_symtab(void);
-void term_symtab(void);
+SYMBOL *lookup_symbol_local(COMPILER *cc, const char *id);
+SYMBOL *lookup_symbol(COMPILER *cc, const char *id);
+SYMTAB *new_symtab(COMPILER *cc, SYMTAB *up);
+SYMTAB *enter_scope(COMPILER *cc);
+void leave_scope(COMPILER *cc);
+SYMTAB *enter_function(COMPILER *cc, SYMBOL *sym);
+void leave_function(COMPILER *cc);
+SYMTAB *get_scope(COMPILER *cc);
+void set_scope(COMPILER *cc, SYMTAB *tab);
+int get_func_var_num(COMPILER *cc);
+bool init_symtab(COMPILER *cc);
+void term_symtab(COMPILER *cc);
 
 const char *get_storage_class_string(STORAGE_CLASS sc);
-void fprint_symtab_1(FILE *fp, int indent, const SYMTAB *tab);
-void print_global_symtab(void);
+void fprint_symtab_1(COMPILER *cc, FILE *fp, int indent, const SYMTAB *tab);
+void fprint_global_symtab(COMPILER *cc, FILE *fp);
+void print_global_symtab(COMPILER *cc);
 
-bool compile_all(FILE *fp);
+bool compile_all(COMPILER *cc, FILE *fp);
 
 typedef enum {
-    TK_EOF, TK_ID, TK_INT_LIT,
-    TK_STATIC, TK_EXTERN, TK_VOID, TK_INT,
-    TK_IF, TK_ELSE, TK_WHILE, TK_FOR, TK_CONTINUE, TK_BREAK, TK_RETURN,
-    TK_COMMA, TK_SEMI, TK_LPAR, TK_RPAR, TK_BEGIN, TK_END,
-    TK_STAR, TK_SLASH, TK_PLUS, TK_MINUS, TK_ASSIGN, TK_LOR, TK_LAND,
-    TK_EQ, TK_NEQ, TK_LT, TK_GT, TK_LE, TK_GE, TK_AND, TK_NOT,
+#define TOKEN_SPECIAL(tk, s)    tk,
+#define TOKEN_KEYWORD(tk, s)    tk,
+#define TOKEN_OPERATOR(tk, s)   tk,
+#include "token.def"
+#undef TOKEN_SPECIAL
+#undef TOKEN_KEYWORD
+#undef TOKEN_OPERATOR
+    TK_COUNT
 } TOKEN;
 
+typedef struct preproc PREPROC;
+typedef struct prescan PRESCAN;
+typedef struct chunk CHUNK;
+
 typedef struct {
+    COMPILER *cc;
     const char *source;
-    int size;
-    int current;
+    size_t size;
+    size_t current;
+    size_t mark;            /* start of the lexeme being scanned */
     int ch;
-    POS pos;
+    SRCLOC base;            /* location of input offset 0 */
+    unsigned range;         /* locations of the input, 1: all at base */
+    SRCLOC loc;             /* of the last token */
     int num;
     char *id;
+    bool bol;               /* no token yet on this line */
+    bool first;             /* the last token began a line */
+    long long start;        /* input offset of the last token */
+    PREPROC *pp;            /* created by next_token() */
+    PRESCAN *prescan;       /* tokens lexed ahead by prescan() */
+    CHUNK *chunk;           /* lexing a part of the source on a thread */
+    int fd;                 /* streamed input, -1 when source is complete */
+    long long offset;       /* input offset of source[0] */
+    char *buffer;
+    size_t buffer_size;
+    void *map;
+    size_t map_size;
 } SCANNER;
 
-SCANNER *open_scanner_text(const char *filename, const char *text);
-SCANNER *open_scanner(const char *filename);
+SCANNER *open_scanner_text(COMPILER *cc, const char *filename,
+                           const char *text);
+SCANNER *open_scanner_at(COMPILER *cc, SRCLOC loc, const char *text,
+                         size_t len);
+SCANNER *open_scanner(COMPILER *cc, const char *filename);
 bool close_scanner(SCANNER *scan);
-TOKEN next_token(SCANNER *scan);
-char *intern(const char *s);
+TOKEN scan_token(SCANNER *scan);
+bool scan_eol(SCANNER *scan);
+void skip_rest_of_line(SCANNER *scan);
+char *scan_rest_of_line(SCANNER *scan);
+char *scan_header_name(SCANNER *scan, bool *system);
+void seek_scanner(SCANNER *scan, size_t offset, bool bol);
+SRCLOC scan_loc(const SCANNER *scan);
+void skip_group(SCANNER *scan);
+char *intern(COMPILER *cc, const char *s);
+char *intern_n(COMPILER *cc, const char *s, size_t len);
+unsigned hash_string(const char *s, size_t len);
+unsigned ident_number(const char *id);
+char *ident_string(COMPILER *cc, unsigned num);
+void print_intern_stats(COMPILER *cc);
+void free_idents(COMPILER *cc);
 const char *token_to_string(TOKEN tk);
-const char *scan_token_to_string(SCANNER *scan, TOKEN tk);
+const char *skip_white(const char *p, const char *end, int *lines);
+const char *skip_to_comment_end(const char *p, const char *end, int *lines);
+const char *skip_to_newline(const char *p, const char *end);
+
+/* prescan.c */
+void set_lex_threads(int n);
+void prescan(SCANNER *scan);
+bool prescanned_token(SCANNER *scan, TOKEN *tk);
+void free_prescan(PRESCAN *ps);
+unsigned chunk_name(CHUNK *c, const char *s, size_t len);
+void chunk_failed(CHUNK *c);
+
+/* preproc.c */
+TOKEN next_token(SCANNER *scan);
+SCANNER *source_scanner(SCANNER *scan);
+void free_preproc(PREPROC *pp);
+void add_include_dir(const char *dir);
+void add_predefine(const char *def);
+
+typedef struct {
+    unsigned char *kind;    /* TOKEN */
+    unsigned *value;        /* identifier number or integer value */
+    SRCLOC *loc;
+    size_t count;
+    size_t capacity;
+    const char *filename;
+} TOKEN_STREAM;
+
+TOKEN_STREAM *new_token_stream(const char *filename);
+void free_token_stream(TOKEN_STREAM *ts);
+TOKEN lex_token(TOKEN_STREAM *ts, SCANNER *scan);
+void lex_all(TOKEN_STREAM *ts, SCANNER *scan);
+void fprint_token(COMPILER *cc, FILE *fp, const TOKEN_STREAM *ts, size_t i);
+const char *token_filename(COMPILER *cc, const TOKEN_STREAM *ts, size_t i);
 
 
 typedef enum {
@@ -164,7 +350,7 @@ typedef enum {
 
 struct node {
     NODE_KIND kind;
-    POS pos;
+    SRCLOC loc;
     TYPE *type;
     union {
         struct {
@@ -174,8 +360,8 @@ struct node {
             NODE *n4;
         } link;
         struct {
-            NODE *left;
-            NODE *right;
+            NODE **stmt;
+            unsigned count;
             SYMTAB *symtab;
         } comp;
         SYMBOL *sym;
@@ -183,35 +369,99 @@ struct node {
     } u;
 };
 
-NODE *new_node(NODE_KIND kind, const POS* pos, TYPE *typ);
-NODE *new_node1(NODE_KIND kind, const POS *pos, TYPE *typ, NODE *n1);
-NODE *new_node2(NODE_KIND kind, const POS *pos, TYPE *typ,
+NODE *new_node(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ);
+NODE *new_node1(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ, NODE *n1);
+NODE *new_node2(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ,
                 NODE *n1, NODE *n2);
-NODE *new_node3(NODE_KIND kind, const POS *pos, TYPE *typ,
+NODE *new_node3(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ,
                 NODE *n1, NODE *n2, NODE *n3);
-NODE *new_node4(NODE_KIND kind, const POS *pos, TYPE *typ,
+NODE *new_node4(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ,
                     NODE *n1, NODE *n2, NODE *n3, NODE *n4);
-NODE *link_node(NODE_KIND kind, const POS *pos, NODE *node, NODE *top);
-NODE *new_node_sym(NODE_KIND kind, const POS *pos, SYMBOL *sym);
-NODE *new_node_int(NODE_KIND kind, const POS *pos, int num);
+NODE *new_node_sym(COMPILER *cc, NODE_KIND kind, SRCLOC loc, SYMBOL *sym);
+NODE *new_node_int(COMPILER *cc, NODE_KIND kind, SRCLOC loc, int num);
 const char *node_kind_to_str(NODE_KIND kind);
 bool node_can_take_addr(const NODE *np);
-void fprint_node(FILE *fp, int indent, const NODE *np);
-void print_node(int indent, const NODE *np);
-
-typedef struct {
+void fprint_node(COMPILER *cc, FILE *fp, int indent, const NODE *np);
+void print_node(COMPILER *cc, int indent, const NODE *np);
+
+/* ast.c */
+typedef struct ast AST;
+typedef unsigned AST_NODE;      /* node number, 0: none */
+
+AST *new_ast(ARENA *a, const NODE *np);
+AST_NODE ast_root(const AST *ast);
+NODE_KIND ast_kind(const AST *ast, AST_NODE n);
+SRCLOC ast_loc(const AST *ast, AST_NODE n);
+TYPE *ast_type(const AST *ast, AST_NODE n);
+unsigned ast_count(const AST *ast, AST_NODE n);
+AST_NODE ast_child(const AST *ast, AST_NODE n, unsigned i);
+AST_NODE ast_chain(const AST *ast, AST_NODE n, bool (*in_chain)(NODE_KIND));
+int ast_num(const AST *ast, AST_NODE n);
+SYMBOL *ast_sym(const AST *ast, AST_NODE n);
+SYMTAB *ast_symtab(const AST *ast, AST_NODE n);
+void print_ast_stats(const char *id, const AST *ast);
+void fprint_ast(COMPILER *cc, FILE *fp, int indent, const AST *ast,
+                AST_NODE n);
+
+typedef struct parser {
+    COMPILER *cc;
     SCANNER *scan;
+    TOKEN_STREAM *tokens;
+    size_t next;            /* index of the token after the current one */
+    bool prelexed;          /* tokens holds the whole input */
     TOKEN token;
+    SRCLOC loc;
+    jmp_buf *recover;       /* where a syntax error goes on */
+    struct pch *pch;        /* image to save at the end of the prefix */
+    bool lazy;              /* function bodies are skipped */
+    struct skipped_body *skipped;   /* in the order of the source */
+    size_t n_skipped;
+    size_t skipped_size;
 } PARSER;
 
-PARSER *open_parser_text(const char *filename, const char *text);
-PARSER *open_parser(const char *filename);
+PARSER *open_parser_text(COMPILER *cc, const char *filename, const char *text);
+PARSER *open_parser(COMPILER *cc, const char *filename);
 bool close_parser(PARSER *pars);
+void prelex(PARSER *pars);
+void skip_bodies(PARSER *pars);
+void set_body_threads(int n);
 bool parse(PARSER *pars);
+bool parse_body(PARSER *pars, SYMBOL *sym);
+bool parse_bodies(PARSER *pars);
+
+/* pch.c */
+typedef struct pch PCH;
+
+typedef enum {
+    PCH_KEY, PCH_FILES, PCH_MACROS, PCH_NAMES, PCH_TOKENS,
+    PCH_TYPES, PCH_PARAMS, PCH_SYMBOLS, PCH_STRINGS, PCH_TEXT,
+    PCH_N_SECTIONS
+} PCH_SECTION;
+
+#define PCH_NONE    0xffffffffu     /* string number of NULL */
+
+PCH *new_pch(const char *path);
+void free_pch(PCH *pch);
+void pch_put(PCH *pch, PCH_SECTION sec, const void *rec, size_t size);
+unsigned pch_count(const PCH *pch, PCH_SECTION sec, size_t size);
+unsigned pch_string(PCH *pch, const char *id);
+bool write_pch(PCH *pch);
+PCH *read_pch(COMPILER *cc, const char *path);
+const void *pch_section(const PCH *pch, PCH_SECTION sec, size_t size,
+                        unsigned *count);
+char *pch_id(PCH *pch, unsigned n);
+void use_pch(PARSER *pars, const char *path);
+void save_prefix(PARSER *pars);
+PREPROC *get_preproc(SCANNER *scan);
+bool check_preproc(PREPROC *pp, PCH *pch);
+void load_preproc(PREPROC *pp, PCH *pch);
+void save_preproc(PREPROC *pp, PCH *pch);
+bool save_symtab(COMPILER *cc, PCH *pch);
+void load_symtab(COMPILER *cc, PCH *pch);
 
 void gen_header(FILE *fp);
-bool compile_node(FILE *fp, const NODE *np);
-bool compile_symbol(FILE *fp, const SYMBOL *sym);
+bool compile_node(COMPILER *cc, FILE *fp, const AST *ast, AST_NODE n);
+bool compile_symbol(COMPILER *cc, FILE *fp, SYMBOL *sym);
 
 
 #endif
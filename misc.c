@@ -1,63 +1,319 @@
+#include <assert.h>
 #include <string.h>
 #include "mcc.h"
 
-jmp_buf g_error_jmp_buf;
+#ifndef MCC_NODEBUG
+unsigned g_debug_mask = 0;
+#endif
 
-static struct debug {
-    struct debug *next;
-    const char *name;
-} *s_debug = NULL;
+void set_debug(DEBUG_CHANNEL ch)
+{
+#ifndef MCC_NODEBUG
+    g_debug_mask |= 1u << ch;
+#endif
+}
 
-bool is_debug(const char *s)
+void *alloc(size_t size)
 {
-    struct debug *d;
-    for (d = s_debug; d != NULL; d = d->next)
-        if (strcmp(d->name, s) == 0)
-            return true;
-    return false;
+    void *p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        abort();
+    }
+    return p;
 }
 
-void set_debug(const char *s)
+/*
+ * arenas
+ * the objects of a file or of a function body are taken from an arena
+ * by bumping a pointer, and freed all at once.  sizes are rounded up to
+ * a multiple of ARENA_ALIGN, so every object is aligned.  the blocks of
+ * a freed arena are kept for the next one; an object larger than a
+ * quarter of a block gets a block of its own.
+ */
+#define ARENA_BLOCK_SIZE    (8 * 1024)
+#define ARENA_ALIGN         8
+
+typedef struct arena_block {
+    struct arena_block *next;
+    union {
+        void *p;
+        long long n;
+    } data[1];
+} ARENA_BLOCK;
+
+struct arena {
+    COMPILER *cc;               /* whose free blocks it takes */
+    char *next, *limit;         /* free part of the current block */
+    ARENA_BLOCK *first, *last;  /* blocks of ARENA_BLOCK_SIZE */
+    ARENA_BLOCK *large;         /* objects of their own */
+};
+
+static ARENA_BLOCK *get_block(COMPILER *cc)
 {
-    if (!is_debug(s)) {
-        struct debug *d = (struct debug*) alloc(sizeof (struct debug));
-        d->name = s;
-        d->next = s_debug;
-        s_debug = d;
+    ARENA_BLOCK *b = cc->free_blocks;
+
+    if (b != NULL)
+        cc->free_blocks = b->next;
+    else
+        b = (ARENA_BLOCK*) alloc(sizeof (ARENA_BLOCK) + ARENA_BLOCK_SIZE);
+    b->next = NULL;
+    return b;
+}
+
+/* the arena itself is the first object in its first block */
+ARENA *new_arena(COMPILER *cc)
+{
+    ARENA_BLOCK *b = get_block(cc);
+    ARENA *a = (ARENA*) b->data;
+
+    a->cc = cc;
+    a->next = (char*) b->data + (sizeof (ARENA) + ARENA_ALIGN - 1)
+                                / ARENA_ALIGN * ARENA_ALIGN;
+    a->limit = (char*) b->data + ARENA_BLOCK_SIZE;
+    a->first = a->last = b;
+    a->large = NULL;
+    return a;
+}
+
+void free_arena(ARENA *a)
+{
+    COMPILER *cc;
+
+    if (a == NULL)
+        return;
+    cc = a->cc;
+    if (cc->arena == a)
+        cc->arena = NULL;
+    while (a->large != NULL) {
+        ARENA_BLOCK *b = a->large;
+        a->large = b->next;
+        free(b);
     }
+    a->last->next = cc->free_blocks;
+    cc->free_blocks = a->first;
 }
 
+/* its blocks go back to cc when it is freed */
+void move_arena(ARENA *a, COMPILER *cc)
+{
+    if (a != NULL)
+        a->cc = cc;
+}
 
-void *alloc(size_t size)
+void *arena_alloc(ARENA *a, size_t size)
 {
-    void *p = malloc(size);
-    if (p == NULL) {
-        fprintf(stderr, "out of memory\n");
-        abort();
+    void *p;
+
+    size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        ARENA_BLOCK *b = (ARENA_BLOCK*) alloc(sizeof (ARENA_BLOCK) + size);
+        b->next = a->large;
+        a->large = b;
+        return b->data;
     }
+    if (size > (size_t) (a->limit - a->next)) {
+        ARENA_BLOCK *b = get_block(a->cc);
+        a->last->next = b;
+        a->last = b;
+        a->next = (char*) b->data;
+        a->limit = (char*) b->data + ARENA_BLOCK_SIZE;
+    }
+    p = a->next;
+    a->next += size;
     return p;
 }
 
-void vwarning(const POS *pos, const char *s, va_list ap)
+/* the arena new_object() takes from */
+void use_arena(COMPILER *cc, ARENA *a)
+{
+    cc->arena = a;
+}
+
+ARENA *current_arena(COMPILER *cc)
+{
+    return cc->arena;
+}
+
+void *new_object(COMPILER *cc, size_t size)
+{
+    assert(cc->arena != NULL);
+    return arena_alloc(cc->arena, size);
+}
+
+COMPILER *new_compiler(void)
 {
-    fprintf(stdout, "%s(%d):warning:", pos->filename, pos->line);
-    vfprintf(stdout, s, ap);
-    fprintf(stdout, "\n");
+    COMPILER *cc = (COMPILER*) alloc(sizeof (COMPILER));
+    memset(cc, 0, sizeof (COMPILER));
+    cc->error_limit = 20;
+    cc->diag_fp = stdout;
+    cc->next_loc = 1;
+    pthread_mutex_init(&cc->type_lock, NULL);
+    return cc;
 }
 
-void verror(const POS *pos, const char *s, va_list ap)
+/*
+ * a compiler for a thread working on a part of the file of cc.  the
+ * identifiers, sources and globals of cc are shared, and only read;
+ * types are made in the table of cc, under its lock.  the scopes, the
+ * arena and the diagnostics are the worker's own.
+ */
+COMPILER *new_worker(COMPILER *cc)
 {
-    fprintf(stdout, "%s(%d):error:", pos->filename, pos->line);
-    vfprintf(stdout, s, ap);
-    fprintf(stdout, "\n");
-    longjmp(g_error_jmp_buf, 1);
+    COMPILER *w = (COMPILER*) alloc(sizeof (COMPILER));
+
+    memcpy(w, cc, sizeof (COMPILER));
+    w->parent = cc;
+    w->error_count = 0;
+    w->diag_len = 0;
+    w->error_mark = NULL;
+    w->free_blocks = NULL;
+    w->arena = NULL;
+    w->current_symtab = cc->global_table;
+    w->current_function = NULL;
+    w->file_arena = NULL;
+    w->type_table = NULL;
+    w->type_size = w->type_count = 0;
+    w->indent = 0;
+    w->body_parser = NULL;
+    w->label_number = 0;
+    return w;
 }
 
-void error(const POS *pos, const char *s, ...)
+/* the diagnostics are flushed first */
+void free_compiler(COMPILER *cc)
+{
+    ARENA_BLOCK *b;
+
+    if (cc == NULL)
+        return;
+    flush_diagnostics(cc);
+    if (cc->parent == NULL) {
+        term_symtab(cc);
+        free_idents(cc);
+        free_sources(cc);
+        pthread_mutex_destroy(&cc->type_lock);
+    }
+    while ((b = cc->free_blocks) != NULL) {
+        cc->free_blocks = b->next;
+        free(b);
+    }
+    free(cc);
+}
+
+/*
+ * diagnostics
+ * messages are collected in a buffer of fixed size, and written out in
+ * one go when it fills up or when flush_diagnostics() is called after a
+ * file.  a file giving more than the error limit is given up.
+ */
+#define DIAG_LINE_SIZE      1024
+
+void set_error_limit(COMPILER *cc, int n)
+{
+    cc->error_limit = n;
+}
+
+int get_error_count(COMPILER *cc)
+{
+    return cc->error_count;
+}
+
+void clear_error_count(COMPILER *cc)
+{
+    cc->error_count = 0;
+}
+
+void flush_diagnostics(COMPILER *cc)
+{
+    fwrite(cc->diag, 1, cc->diag_len, cc->diag_fp);
+    cc->diag_len = 0;
+}
+
+static void put_diagnostic(COMPILER *cc, SRCLOC loc, const char *level,
+                           const char *s, va_list ap)
+{
+    char line[DIAG_LINE_SIZE];
+    POS pos = decode_loc(cc, loc);
+    int n;
+
+    n = snprintf(line, sizeof line, "%s(%d):%s:",
+                 pos.filename, pos.line, level);
+    if (n < 0 || n > (int) sizeof line - 2)
+        n = 0;
+    n += vsnprintf(line + n, sizeof line - n, s, ap);
+    if (n > (int) sizeof line - 2)
+        n = sizeof line - 2;
+    line[n++] = '\n';
+    if (cc->diag_len + n > sizeof cc->diag)
+        flush_diagnostics(cc);
+    memcpy(cc->diag + cc->diag_len, line, n);
+    cc->diag_len += n;
+}
+
+static void put_error_limit(COMPILER *cc, SRCLOC loc, ...)
+{
+    va_list ap;
+    va_start(ap, loc);
+    put_diagnostic(cc, loc, "error",
+                   "too many errors, giving up (-ferror-limit=%d)", ap);
+    va_end(ap);
+}
+
+/* the file is given up, the error limit reached at loc */
+void give_up(COMPILER *cc, SRCLOC loc)
+{
+    put_error_limit(cc, loc, cc->error_limit);
+    longjmp(cc->error_jmp_buf, 1);
+}
+
+/*
+ * an error has been put.  the error marks let the output of a worker
+ * be cut at the error limit of the whole file, see parser.c.
+ */
+static void count_error(COMPILER *cc, SRCLOC loc)
+{
+    if (cc->error_mark != NULL && cc->error_count < cc->error_limit) {
+        cc->error_mark[cc->error_count].end = ftell(cc->diag_fp)
+                                              + (long) cc->diag_len;
+        cc->error_mark[cc->error_count].loc = loc;
+    }
+    cc->error_count++;
+}
+
+/* an error the caller goes on from */
+void vreport_error(COMPILER *cc, SRCLOC loc, const char *s, va_list ap)
+{
+    put_diagnostic(cc, loc, "error", s, ap);
+    count_error(cc, loc);
+    if (cc->error_count == cc->error_limit)
+        give_up(cc, loc);
+}
+
+void vwarning(COMPILER *cc, SRCLOC loc, const char *s, va_list ap)
+{
+    put_diagnostic(cc, loc, "warning", s, ap);
+}
+
+void verror(COMPILER *cc, SRCLOC loc, const char *s, va_list ap)
+{
+    put_diagnostic(cc, loc, "error", s, ap);
+    count_error(cc, loc);
+    longjmp(cc->error_jmp_buf, 1);
+}
+
+void warning(COMPILER *cc, SRCLOC loc, const char *s, ...)
 {
     va_list ap;
     va_start(ap, s);
-    verror(pos, s, ap);
+    vwarning(cc, loc, s, ap);
     va_end(ap);
 }
 
+void error(COMPILER *cc, SRCLOC loc, const char *s, ...)
+{
+    va_list ap;
+    va_start(ap, s);
+    verror(cc, loc, s, ap);
+    va_end(ap);
+}
@@ -0,0 +1,446 @@
+/*
+ * mkfirst - generate the parser tables (firsttab.h) from the grammar
+ *
+ *   NT_xxx         a number for each nonterminal of the grammar
+ *   s_grammar      its FIRST and FOLLOW sets, as bitsets of tokens
+ *
+ * usage: mkfirst syntax.ansic.txt > firsttab.h
+ *
+ * a rule begins with its nonterminal at the start of a line, and each
+ * alternative with '=' or '|'.  a symbol with a lower case letter is a
+ * nonterminal; IDENTIFIER and other upper case names and quoted
+ * punctuators are terminals, matched to token.def by spelling.
+ * [x] is optional and {x} repeated.  terminals token.def does not have
+ * yet take part in the sets, but are left out of the tables.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef enum {
+    SPECIAL, KEYWORD, OPERATOR
+} TOKEN_CLASS;
+
+static const struct token {
+    const char *name;
+    const char *spelling;
+    TOKEN_CLASS cls;
+} s_tokens[] = {
+#define TOKEN_SPECIAL(tk, s)    { #tk, s, SPECIAL },
+#define TOKEN_KEYWORD(tk, s)    { #tk, s, KEYWORD },
+#define TOKEN_OPERATOR(tk, s)   { #tk, s, OPERATOR },
+#include "token.def"
+#undef TOKEN_SPECIAL
+#undef TOKEN_KEYWORD
+#undef TOKEN_OPERATOR
+};
+
+/* terminals of the grammar named other than their token */
+static const struct {
+    const char *name;
+    const char *token;
+} s_aliases[] = {
+    { "IDENTIFIER",         "TK_ID" },
+    { "INTEGER_CONSTANT",   "TK_INT_LIT" },
+};
+
+#define N_TOKENS        ((int) (sizeof (s_tokens) / sizeof (s_tokens[0])))
+#define N_ALIASES       ((int) (sizeof (s_aliases) / sizeof (s_aliases[0])))
+#define MAX_SYMBOLS     512
+#define MAX_PRODS       1024
+#define MAX_RHS         32
+#define MAX_TERMINALS   256
+#define SET_WORDS       (MAX_TERMINALS / 32)
+#define NAME_SIZE       64
+
+typedef unsigned SET[SET_WORDS];
+
+static struct symbol {
+    char name[NAME_SIZE];
+    int terminal;       /* bit of a terminal, -1: a nonterminal */
+    int defined;
+    int generated;      /* made for a [x] or {x} */
+    int nullable;
+    SET first;
+    SET follow;
+} s_symbols[MAX_SYMBOLS];
+static int s_n_symbols;
+static int s_n_terminals = N_TOKENS;    /* known tokens first */
+
+static struct prod {
+    int lhs;
+    int n;
+    int rhs[MAX_RHS];
+} s_prods[MAX_PRODS];
+static int s_n_prods;
+
+/* the grammar text, and the symbol just read from it */
+static const char *s_begin;
+static const char *s_text;
+static const char *s_filename;
+static int s_line = 1;
+static int s_tok;               /* a character, 'a' (name), '\'' or 0 */
+static int s_at_bol;            /* the name began a line */
+static char s_name[NAME_SIZE];
+
+static void fail(const char *s, const char *arg)
+{
+    fprintf(stderr, "mkfirst: ");
+    if (s_filename != NULL)
+        fprintf(stderr, "%s(%d): ", s_filename, s_line);
+    fprintf(stderr, s, arg);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static char *read_file(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    char *text;
+    long size;
+
+    if (fp == NULL)
+        fail("can't open '%s'", filename);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    text = (char*) malloc(size + 1);
+    if (text == NULL || fread(text, 1, size, fp) != (size_t) size)
+        fail("can't read '%s'", filename);
+    text[size] = '\0';
+    fclose(fp);
+    return text;
+}
+
+static void next_symbol(void)
+{
+    const char *p = s_text;
+    size_t n;
+
+    for (;;) {
+        if (*p == '\n')
+            s_line++;
+        if (isspace((unsigned char) *p))
+            p++;
+        else if (p[0] == '/' && p[1] == '*') {
+            for (p += 2; *p && !(p[0] == '*' && p[1] == '/'); p++)
+                if (*p == '\n')
+                    s_line++;
+            if (*p == '\0')
+                fail("unterminated comment", NULL);
+            p += 2;
+        } else
+            break;
+    }
+    s_at_bol = (p == s_begin || p[-1] == '\n');
+    if (isalpha((unsigned char) *p) || *p == '_') {
+        for (n = 0; isalnum((unsigned char) p[n]) || p[n] == '_'; n++)
+            ;
+        s_tok = 'a';
+    } else if (*p == '\'') {
+        for (n = 1; p[n] && p[n] != '\'' && p[n] != '\n'; n++)
+            ;
+        if (p[n] != '\'')
+            fail("unterminated quote", NULL);
+        p++;
+        n--;
+        s_tok = '\'';
+    } else {
+        s_tok = *p;
+        s_text = *p ? p + 1 : p;
+        return;
+    }
+    if (n >= NAME_SIZE)
+        fail("name too long", NULL);
+    memcpy(s_name, p, n);
+    s_name[n] = '\0';
+    s_text = p + n + (s_tok == '\'');
+}
+
+static int new_symbol(const char *name, int terminal)
+{
+    struct symbol *sym;
+
+    if (s_n_symbols == MAX_SYMBOLS)
+        fail("too many symbols", NULL);
+    sym = &s_symbols[s_n_symbols];
+    strcpy(sym->name, name);
+    sym->terminal = terminal;
+    return s_n_symbols++;
+}
+
+/* the bit of a terminal, by its spelling in the grammar */
+static int token_bit(const char *name, int quoted)
+{
+    char lower[NAME_SIZE];
+    int i;
+
+    for (i = 0; i < N_ALIASES; i++) {
+        if (!quoted && strcmp(name, s_aliases[i].name) == 0)
+            name = s_aliases[i].token;
+    }
+    for (i = 0; name[i]; i++)
+        lower[i] = tolower((unsigned char) name[i]);
+    lower[i] = '\0';
+    for (i = 0; i < N_TOKENS; i++) {
+        if (quoted ? s_tokens[i].cls == OPERATOR
+                        && strcmp(name, s_tokens[i].spelling) == 0
+                   : strcmp(name, s_tokens[i].name) == 0
+                        || (s_tokens[i].cls == KEYWORD
+                            && strcmp(lower, s_tokens[i].spelling) == 0))
+            return i;
+    }
+    if (s_n_terminals == MAX_TERMINALS)
+        fail("too many terminals", NULL);
+    return s_n_terminals++;
+}
+
+static int lookup(const char *name, int quoted)
+{
+    int i, nonterminal = 0;
+
+    for (i = 0; name[i]; i++)
+        nonterminal |= islower((unsigned char) name[i]) != 0;
+    nonterminal &= !quoted;
+    for (i = 0; i < s_n_symbols; i++) {
+        if (strcmp(s_symbols[i].name, name) == 0
+                && (s_symbols[i].terminal < 0) == nonterminal
+                && !s_symbols[i].generated)
+            return i;
+    }
+    return new_symbol(name, nonterminal ? -1 : token_bit(name, quoted));
+}
+
+static int add_prod(int lhs)
+{
+    if (s_n_prods == MAX_PRODS)
+        fail("too many rules", NULL);
+    s_prods[s_n_prods].lhs = lhs;
+    s_prods[s_n_prods].n = 0;
+    return s_n_prods++;
+}
+
+static void add_rhs(int prod, int sym)
+{
+    if (s_prods[prod].n == MAX_RHS)
+        fail("alternative too long", NULL);
+    s_prods[prod].rhs[s_prods[prod].n++] = sym;
+}
+
+/* symbols up to the end of an alternative, or the close of a group */
+static void parse_sequence(int prod, int close)
+{
+    while (s_tok != 0 && s_tok != close) {
+        if (s_tok == 'a' && s_at_bol)
+            break;
+        if (s_tok == 'a' || s_tok == '\'') {
+            add_rhs(prod, lookup(s_name, s_tok == '\''));
+            next_symbol();
+        } else if (s_tok == '[' || s_tok == '{') {
+            /* opt = x | (empty), rep = x rep | (empty) */
+            int open = s_tok;
+            int g = new_symbol(s_symbols[s_prods[prod].lhs].name, -1);
+            int p = add_prod(g);
+            s_symbols[g].generated = s_symbols[g].defined = 1;
+            next_symbol();
+            parse_sequence(p, open == '[' ? ']' : '}');
+            if (s_tok != (open == '[' ? ']' : '}'))
+                fail("unbalanced '%c'", open == '[' ? "[" : "{");
+            next_symbol();
+            if (open == '{')
+                add_rhs(p, g);
+            add_prod(g);
+            add_rhs(prod, g);
+        } else if (s_tok == '=' || s_tok == '|') {
+            if (close != 0)
+                fail("alternatives in a group", NULL);
+            break;
+        } else {
+            char c[2];
+            c[0] = s_tok;
+            c[1] = '\0';
+            fail("unexpected '%s'", c);
+        }
+    }
+}
+
+static void read_grammar(const char *filename)
+{
+    s_begin = s_text = read_file(filename);
+    s_filename = filename;
+    next_symbol();
+    while (s_tok != 0) {
+        int lhs;
+        if (s_tok != 'a' || !s_at_bol)
+            fail("a rule must begin a line", NULL);
+        lhs = lookup(s_name, 0);
+        if (s_symbols[lhs].terminal >= 0)
+            fail("'%s' is a terminal", s_name);
+        if (s_symbols[lhs].defined)
+            fail("'%s' is defined twice", s_name);
+        s_symbols[lhs].defined = 1;
+        next_symbol();
+        if (s_tok != '=' && s_tok != '|')
+            fail("'=' expected after '%s'", s_symbols[lhs].name);
+        while (s_tok == '=' || s_tok == '|') {
+            next_symbol();
+            parse_sequence(add_prod(lhs), 0);
+        }
+    }
+    s_filename = NULL;
+}
+
+static int set_union(SET a, const SET b)
+{
+    int i, changed = 0;
+
+    for (i = 0; i < SET_WORDS; i++) {
+        changed |= (b[i] & ~a[i]) != 0;
+        a[i] |= b[i];
+    }
+    return changed;
+}
+
+static void set_add(SET a, int bit)
+{
+    a[bit / 32] |= 1u << (bit % 32);
+}
+
+static int set_has(const SET a, int bit)
+{
+    return (a[bit / 32] >> (bit % 32)) & 1;
+}
+
+/* nullable and FIRST, then FOLLOW, each until nothing changes */
+static void build_sets(void)
+{
+    int i, j, k, changed;
+
+    for (i = 0; i < s_n_symbols; i++) {
+        if (s_symbols[i].terminal >= 0)
+            set_add(s_symbols[i].first, s_symbols[i].terminal);
+        else if (!s_symbols[i].defined)
+            fail("'%s' is not defined", s_symbols[i].name);
+    }
+    do {
+        changed = 0;
+        for (i = 0; i < s_n_prods; i++) {
+            struct prod *p = &s_prods[i];
+            struct symbol *lhs = &s_symbols[p->lhs];
+            for (j = 0; j < p->n; j++) {
+                changed |= set_union(lhs->first, s_symbols[p->rhs[j]].first);
+                if (!s_symbols[p->rhs[j]].nullable)
+                    break;
+            }
+            if (j == p->n && !lhs->nullable)
+                changed = lhs->nullable = 1;
+        }
+    } while (changed);
+
+    set_add(s_symbols[s_prods[0].lhs].follow, 0);       /* TK_EOF */
+    do {
+        changed = 0;
+        for (i = 0; i < s_n_prods; i++) {
+            struct prod *p = &s_prods[i];
+            for (j = 0; j < p->n; j++) {
+                struct symbol *sym = &s_symbols[p->rhs[j]];
+                if (sym->terminal >= 0)
+                    continue;
+                for (k = j + 1; k < p->n; k++) {
+                    changed |= set_union(sym->follow,
+                                         s_symbols[p->rhs[k]].first);
+                    if (!s_symbols[p->rhs[k]].nullable)
+                        break;
+                }
+                if (k == p->n)
+                    changed |= set_union(sym->follow,
+                                         s_symbols[p->lhs].follow);
+            }
+        }
+    } while (changed);
+}
+
+static void print_names(const char *label, const SET set)
+{
+    int i, column = 7 + strlen(label);
+
+    printf("    /* %s", label);
+    for (i = 0; i < N_TOKENS; i++) {
+        if (!set_has(set, i))
+            continue;
+        if (column + 1 + strlen(s_tokens[i].name) > 76) {
+            printf("\n      ");
+            column = 6;
+        }
+        column += printf(" %s", s_tokens[i].name);
+    }
+    printf(" */\n");
+}
+
+static void print_words(const SET set)
+{
+    int i;
+
+    printf("{");
+    for (i = 0; i < (N_TOKENS + 31) / 32; i++) {
+        unsigned w = set[i];
+        if (i == N_TOKENS / 32 && N_TOKENS % 32 != 0)
+            w &= (1u << (N_TOKENS % 32)) - 1;
+        printf("%s0x%08x", i ? ", " : " ", w);
+    }
+    printf(" }");
+}
+
+static void print_tables(void)
+{
+    int i, j;
+    char name[NAME_SIZE];
+
+    printf("/* generated by mkfirst from %s -- do not edit */\n\n",
+           "syntax.ansic.txt");
+    printf("enum {\n");
+    for (i = 0; i < s_n_symbols; i++) {
+        if (s_symbols[i].terminal >= 0 || s_symbols[i].generated)
+            continue;
+        for (j = 0; s_symbols[i].name[j]; j++)
+            name[j] = toupper((unsigned char) s_symbols[i].name[j]);
+        name[j] = '\0';
+        printf("    NT_%s,\n", name);
+    }
+    printf("    NT_COUNT\n};\n\n");
+
+    printf("#define TOKEN_SET_WORDS %d\n\n", (N_TOKENS + 31) / 32);
+    printf("/* token t is bit t %% 32 of word t / 32 */\n");
+    printf("static const struct {\n");
+    printf("    unsigned first[TOKEN_SET_WORDS];\n");
+    printf("    unsigned follow[TOKEN_SET_WORDS];\n");
+    printf("} s_grammar[NT_COUNT] = {\n");
+    for (i = 0; i < s_n_symbols; i++) {
+        const struct symbol *sym = &s_symbols[i];
+        if (sym->terminal >= 0 || sym->generated)
+            continue;
+        printf("    /* %s%s */\n", sym->name,
+               sym->nullable ? " (may be empty)" : "");
+        print_names("first:", sym->first);
+        print_names("follow:", sym->follow);
+        printf("    { ");
+        print_words(sym->first);
+        printf(", ");
+        print_words(sym->follow);
+        printf(" },\n");
+    }
+    printf("};\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: mkfirst grammar\n");
+        return 1;
+    }
+    read_grammar(argv[1]);
+    build_sets();
+    print_tables();
+    return 0;
+}
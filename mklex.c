@@ -0,0 +1,200 @@
+/*
+ * mklex - generate the scanner tables (lextab.h) from token.def
+ *
+ *   s_char_flags   character classification
+ *   s_op_class     character -> operator character class
+ *   s_op_next      operator DFA transitions [state][class], 0: stop
+ *   s_op_token     token accepted in each state, TK_EOF: none
+ *   s_keywords     keyword table, indexed by a perfect hash
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    SPECIAL, KEYWORD, OPERATOR
+} TOKEN_CLASS;
+
+static const struct token {
+    const char *name;
+    const char *spelling;
+    TOKEN_CLASS cls;
+} s_tokens[] = {
+#define TOKEN_SPECIAL(tk, s)    { #tk, s, SPECIAL },
+#define TOKEN_KEYWORD(tk, s)    { #tk, s, KEYWORD },
+#define TOKEN_OPERATOR(tk, s)   { #tk, s, OPERATOR },
+#include "token.def"
+#undef TOKEN_SPECIAL
+#undef TOKEN_KEYWORD
+#undef TOKEN_OPERATOR
+};
+
+#define N_TOKENS        ((int) (sizeof (s_tokens) / sizeof (s_tokens[0])))
+#define MAX_STATES      256
+#define MAX_CLASSES     64
+#define MAX_HASH_SIZE   1024
+
+#define CF_WHITE    1
+#define CF_ALPHA    2
+#define CF_DIGIT    4
+
+static int s_class[256];
+static int s_n_classes = 1;
+static int s_next[MAX_STATES][MAX_CLASSES];
+static int s_accept[MAX_STATES];
+static int s_n_states = 1;
+
+static int s_hash_size;
+static int s_hash_mult;
+static int s_slot[MAX_HASH_SIZE];
+
+static void fail(const char *s, const char *arg)
+{
+    fprintf(stderr, "mklex: ");
+    fprintf(stderr, s, arg);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static void build_dfa(void)
+{
+    int i;
+    const char *p;
+
+    for (i = 0; i < MAX_STATES; i++)
+        s_accept[i] = -1;
+    for (i = 0; i < N_TOKENS; i++) {
+        int state = 0;
+        if (s_tokens[i].cls != OPERATOR)
+            continue;
+        for (p = s_tokens[i].spelling; *p; p++) {
+            int c = (unsigned char) *p;
+            if (s_class[c] == 0) {
+                if (s_n_classes == MAX_CLASSES)
+                    fail("too many operator characters", NULL);
+                s_class[c] = s_n_classes++;
+            }
+            if (s_next[state][s_class[c]] == 0) {
+                if (s_n_states == MAX_STATES)
+                    fail("too many operator states", NULL);
+                s_next[state][s_class[c]] = s_n_states++;
+            }
+            state = s_next[state][s_class[c]];
+        }
+        if (s_accept[state] >= 0)
+            fail("duplicated operator '%s'", s_tokens[i].spelling);
+        s_accept[state] = i;
+    }
+}
+
+static int keyword_hash(const char *s, int mult)
+{
+    int len = strlen(s);
+    return (len + (unsigned char) s[0] * mult
+                + (unsigned char) s[len-1]) & (s_hash_size - 1);
+}
+
+/* smallest table, then smallest multiplier, without collisions */
+static void build_keyword_hash(void)
+{
+    int i, h;
+
+    for (s_hash_size = 16; s_hash_size <= MAX_HASH_SIZE; s_hash_size *= 2) {
+        for (s_hash_mult = 1; s_hash_mult < 256; s_hash_mult++) {
+            for (h = 0; h < s_hash_size; h++)
+                s_slot[h] = -1;
+            for (i = 0; i < N_TOKENS; i++) {
+                if (s_tokens[i].cls != KEYWORD)
+                    continue;
+                h = keyword_hash(s_tokens[i].spelling, s_hash_mult);
+                if (s_slot[h] >= 0)
+                    break;
+                s_slot[h] = i;
+            }
+            if (i == N_TOKENS)
+                return;
+        }
+    }
+    fail("no perfect hash for the keywords", NULL);
+}
+
+static int char_flags(int c)
+{
+    if (c == ' ' || (c >= '\t' && c <= '\r'))
+        return CF_WHITE;
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
+        return CF_ALPHA;
+    if (c >= '0' && c <= '9')
+        return CF_DIGIT;
+    return 0;
+}
+
+static void print_table(const char *decl, const int *v, int n)
+{
+    int i;
+    printf("%s = {", decl);
+    for (i = 0; i < n; i++)
+        printf("%s%2d,", (i % 16 == 0) ? "\n    " : " ", v[i]);
+    printf("\n};\n\n");
+}
+
+static void print_tables(void)
+{
+    int v[256];
+    int i, j;
+
+    printf("/* generated by mklex from token.def -- do not edit */\n\n");
+
+    printf("#define CF_WHITE    %d\n", CF_WHITE);
+    printf("#define CF_ALPHA    %d\n", CF_ALPHA);
+    printf("#define CF_DIGIT    %d\n\n", CF_DIGIT);
+    for (i = 0; i < 256; i++)
+        v[i] = char_flags(i);
+    print_table("static const unsigned char s_char_flags[256]", v, 256);
+
+    printf("#define OP_CLASSES  %d\n", s_n_classes);
+    printf("#define OP_STATES   %d\n\n", s_n_states);
+    print_table("static const unsigned char s_op_class[256]", s_class, 256);
+
+    printf("static const unsigned char s_op_next[OP_STATES][OP_CLASSES]"
+           " = {\n");
+    for (i = 0; i < s_n_states; i++) {
+        printf("    {");
+        for (j = 0; j < s_n_classes; j++)
+            printf("%s%d", j ? ", " : " ", s_next[i][j]);
+        printf(" },\n");
+    }
+    printf("};\n\n");
+
+    printf("static const unsigned char s_op_token[OP_STATES] = {\n");
+    for (i = 0; i < s_n_states; i++)
+        printf("    %s,\n", s_accept[i] < 0 ? "TK_EOF"
+                                            : s_tokens[s_accept[i]].name);
+    printf("};\n\n");
+
+    printf("#define KEYWORD_TABLE_SIZE  %d\n", s_hash_size);
+    printf("#define KEYWORD_HASH(len, first, last) \\\n"
+           "    (((len) + (first) * %d + (last)) & "
+           "(KEYWORD_TABLE_SIZE - 1))\n\n", s_hash_mult);
+    printf("static const struct keyword s_keywords[KEYWORD_TABLE_SIZE]"
+           " = {\n");
+    for (i = 0; i < s_hash_size; i++) {
+        const struct token *tk;
+        if (s_slot[i] < 0) {
+            printf("    { NULL, 0, TK_ID },\n");
+            continue;
+        }
+        tk = &s_tokens[s_slot[i]];
+        printf("    { \"%s\", %d, %s },\n",
+                tk->spelling, (int) strlen(tk->spelling), tk->name);
+    }
+    printf("};\n");
+}
+
+int main(void)
+{
+    build_dfa();
+    build_keyword_hash();
+    print_tables();
+    return 0;
+}
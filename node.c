@@ -1,45 +1,46 @@
 #include <assert.h>
 #include "mcc.h"
 
-NODE *new_node(NODE_KIND kind, const POS *pos, TYPE *typ)
+NODE *new_node(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ)
 {
-    NODE *np = (NODE*) alloc(sizeof (NODE));
+    NODE *np = (NODE*) new_object(cc, sizeof (NODE));
     np->kind = kind;
-    np->pos = *pos;
+    np->loc = loc;
     np->type = typ;
     np->u.link.n1 = np->u.link.n2 = np->u.link.n3 = np->u.link.n4 = NULL;
     return np;
 }
 
-NODE *new_node1(NODE_KIND kind, const POS *pos, TYPE *typ, NODE *n1)
+NODE *new_node1(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ, NODE *n1)
 {
-    NODE *np = new_node(kind, pos, typ);
+    NODE *np = new_node(cc, kind, loc, typ);
     np->u.link.n1 = n1;
     return np;
 }
 
-NODE *new_node2(NODE_KIND kind, const POS *pos, TYPE *typ, NODE *n1, NODE *n2)
+NODE *new_node2(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ,
+                NODE *n1, NODE *n2)
 {
-    NODE *np = new_node(kind, pos, typ);
+    NODE *np = new_node(cc, kind, loc, typ);
     np->u.link.n1 = n1;
     np->u.link.n2 = n2;
     return np;
 }
 
-NODE *new_node3(NODE_KIND kind, const POS *pos, TYPE *typ,
+NODE *new_node3(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ,
                 NODE *n1, NODE *n2, NODE *n3)
 {
-    NODE *np = new_node(kind, pos, typ);
+    NODE *np = new_node(cc, kind, loc, typ);
     np->u.link.n1 = n1;
     np->u.link.n2 = n2;
     np->u.link.n3 = n3;
     return np;
 }
 
-NODE *new_node4(NODE_KIND kind, const POS *pos, TYPE *typ,
+NODE *new_node4(COMPILER *cc, NODE_KIND kind, SRCLOC loc, TYPE *typ,
                 NODE *n1, NODE *n2, NODE *n3, NODE *n4)
 {
-    NODE *np = new_node(kind, pos, typ);
+    NODE *np = new_node(cc, kind, loc, typ);
     np->u.link.n1 = n1;
     np->u.link.n2 = n2;
     np->u.link.n3 = n3;
@@ -47,34 +48,18 @@ NODE *new_node4(NODE_KIND kind, const POS *pos, TYPE *typ,
     return np;
 }
 
-NODE *link_node(NODE_KIND kind, const POS *pos, NODE *node, NODE *top)
+NODE *new_node_sym(COMPILER *cc, NODE_KIND kind, SRCLOC loc, SYMBOL *sym)
 {
     NODE *np;
-    NODE *p;
-
-    np = new_node(kind, pos, NULL);
-    np->u.comp.left = node;
-    np->u.comp.right = NULL;
-    if (top == NULL)
-        return np;
-    for (p = top; p->u.comp.right != NULL; p = p->u.comp.right)
-        ;
-    p->u.comp.right = np;
-    return top;
-}
-
-NODE *new_node_sym(NODE_KIND kind, const POS *pos, SYMBOL *sym)
-{
-    NODE *np;
-    np = new_node(kind, pos, sym->type);
+    np = new_node(cc, kind, loc, sym->type);
     np->u.sym = sym;
     return np;
 }
 
-NODE *new_node_int(NODE_KIND kind, const POS *pos, int num)
+NODE *new_node_int(COMPILER *cc, NODE_KIND kind, SRCLOC loc, int num)
 {
     NODE *np;
-    np = new_node(kind, pos, (num == 0) ? &g_type_null : &g_type_int);
+    np = new_node(cc, kind, loc, (num == 0) ? &g_type_null : &g_type_int);
     np->u.num = num;
     return np;
 }
@@ -109,91 +94,116 @@ const char *node_kind_to_str(NODE_KIND kind)
     return "";
 }
 
-void fprint_node(FILE *fp, int indent, const NODE *np)
+/* operators printed between their operands */
+static bool is_infix(NODE_KIND kind)
 {
-    if (np == NULL) {
+    switch (kind) {
+    case NK_ASSIGN:
+    case NK_LOR:
+    case NK_LAND:
+    case NK_EQ:
+    case NK_NEQ:
+    case NK_LT:
+    case NK_GT:
+    case NK_LE:
+    case NK_GE:
+    case NK_ADD:
+    case NK_SUB:
+    case NK_MUL:
+    case NK_DIV:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void fprint_ast(COMPILER *cc, FILE *fp, int indent, const AST *ast, AST_NODE n)
+{
+    unsigned i;
+    AST_NODE m, inner;
+    SRCLOC loc;
+
+    if (n == 0) {
         return;
     }
-    switch (np->kind) {
-    case NK_LINK:
-        fprint_node(fp, indent, np->u.comp.left);
-        fprint_node(fp, indent, np->u.comp.right);
-        break;
+    loc = ast_loc(ast, n);
+    switch (ast_kind(ast, n)) {
     case NK_COMPOUND:
-        if (is_debug("node"))
+        if (is_debug(DEBUG_NODE))
             fprintf(fp, "%*s%s(%d):", indent, "",
-                    np->pos.filename, np->pos.line);
+                    loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*s{\n", indent, "");
-        if (np->u.comp.symtab) {
-            fprint_symtab_1(fp, indent+2, np->u.comp.symtab);
+        if (ast_symtab(ast, n)) {
+            fprint_symtab_1(cc, fp, indent+2, ast_symtab(ast, n));
         }
-        fprint_node(fp, indent+2, np->u.comp.left);
+        for (i = 0; i < ast_count(ast, n); i++)
+            fprint_ast(cc, fp, indent+2, ast, ast_child(ast, n, i));
         fprintf(fp, "%*s}\n", indent, "");
         break;
     case NK_IF:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*sif (", indent, "");
-        fprint_node(fp, indent, np->u.link.n1);
+        fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 0));
         fprintf(fp, ")\n");
-        fprint_node(fp, indent+2, np->u.link.n2);
-        if (np->u.link.n3) {
+        fprint_ast(cc, fp, indent+2, ast, ast_child(ast, n, 1));
+        if (ast_child(ast, n, 2)) {
             fprintf(fp, "%*selse\n", indent, "");
-            fprint_node(fp, indent+2, np->u.link.n3);
+            fprint_ast(cc, fp, indent+2, ast, ast_child(ast, n, 2));
         }
         break;
     case NK_WHILE:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*swhile (", indent, "");
-        fprint_node(fp, indent, np->u.link.n1);
+        fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 0));
         fprintf(fp, ")\n");
-        fprint_node(fp, indent+2, np->u.link.n2);
+        fprint_ast(cc, fp, indent+2, ast, ast_child(ast, n, 1));
         break;
     case NK_FOR:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*sfor (", indent, "");
-        fprint_node(fp, indent, np->u.link.n1);
+        fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 0));
         fprintf(fp, "; ");
-        fprint_node(fp, indent, np->u.link.n2);
+        fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 1));
         fprintf(fp, "; ");
-        fprint_node(fp, indent, np->u.link.n3);
+        fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 2));
         fprintf(fp, ")\n");
-        fprint_node(fp, indent+2, np->u.link.n4);
+        fprint_ast(cc, fp, indent+2, ast, ast_child(ast, n, 3));
         break;
     case NK_CONTINUE:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*scontinue;\n", indent, "");
         break;
     case NK_BREAK:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*sbreak;\n", indent, "");
         break;
     case NK_RETURN:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*sreturn ", indent, "");
-        if (np->u.link.n1)
-            fprint_node(fp, indent, np->u.link.n1);
+        if (ast_child(ast, n, 0))
+            fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 0));
         fprintf(fp, ";\n");
-        if (is_debug("node")) {
+        if (is_debug(DEBUG_NODE)) {
             fprintf(fp, " : ");
-            fprint_type(fp, np->type);
+            fprint_type(fp, ast_type(ast, n));
             fprintf(fp, "\n");
         }
         break;
     case NK_EXPR:
-        if (is_debug("node"))
-            fprintf(fp, "%s(%d):", np->pos.filename, np->pos.line);
+        if (is_debug(DEBUG_NODE))
+            fprintf(fp, "%s(%d):", loc_filename(cc, loc), loc_line(cc, loc));
         fprintf(fp, "%*s", indent, "");
-        fprint_node(fp, indent, np->u.link.n1);
+        fprint_ast(cc, fp, indent, ast, ast_child(ast, n, 0));
         fprintf(fp, ";\n");
-        if (is_debug("node")) {
+        if (is_debug(DEBUG_NODE)) {
             fprintf(fp, " : ");
-            fprint_type(fp, np->type);
+            fprint_type(fp, ast_type(ast, n));
             fprintf(fp, "\n");
         }
         break;
@@ -210,70 +220,88 @@ void fprint_node(FILE *fp, int indent, const NODE *np)
     case NK_SUB:
     case NK_MUL:
     case NK_DIV:
-        fprintf(fp, "(");
-        fprint_node(fp, 0, np->u.link.n1);
-        fprintf(fp, " %s ", node_kind_to_str(np->kind));
-        fprint_node(fp, 0, np->u.link.n2);
-        fprintf(fp, ")");
-        if (is_debug("node")) {
-            fprintf(fp, " : ");
-            fprint_type(fp, np->type);
-            fprintf(fp, "\n");
+        /* a chain of left operands, from the innermost up */
+        inner = ast_chain(ast, n, is_infix);
+        for (m = n; m < inner; m++)
+            fprintf(fp, "(");
+        fprint_ast(cc, fp, 0, ast, inner);
+        for (m = inner; m-- > n; ) {
+            fprintf(fp, " %s ", node_kind_to_str(ast_kind(ast, m)));
+            fprint_ast(cc, fp, 0, ast, ast_child(ast, m, 1));
+            fprintf(fp, ")");
+            if (is_debug(DEBUG_NODE)) {
+                fprintf(fp, " : ");
+                fprint_type(fp, ast_type(ast, m));
+                fprintf(fp, "\n");
+            }
         }
         break;
     case NK_ADDR:
     case NK_INDIR:
     case NK_MINUS:
     case NK_NOT:
-        fprintf(fp, "(%s", node_kind_to_str(np->kind));
-        fprint_node(fp, 0, np->u.link.n1);
+        fprintf(fp, "(%s", node_kind_to_str(ast_kind(ast, n)));
+        fprint_ast(cc, fp, 0, ast, ast_child(ast, n, 0));
         fprintf(fp, ")");
-        if (is_debug("node")) {
+        if (is_debug(DEBUG_NODE)) {
             fprintf(fp, " : ");
-            fprint_type(fp, np->type);
+            fprint_type(fp, ast_type(ast, n));
             fprintf(fp, "\n");
         }
         break;
     case NK_ID:
-        assert(np->u.sym);
-        fprintf(fp, "%s", np->u.sym->id);
-        if (is_debug("node")) {
+        assert(ast_sym(ast, n));
+        fprintf(fp, "%s", ast_sym(ast, n)->id);
+        if (is_debug(DEBUG_NODE)) {
             fprintf(fp, " : ");
-            fprint_type(fp, np->type);
+            fprint_type(fp, ast_type(ast, n));
             fprintf(fp, "\n");
         }
         break;
     case NK_INT_LIT:
-        fprintf(fp, "%d", np->u.num);
-        if (is_debug("node")) {
+        fprintf(fp, "%d", ast_num(ast, n));
+        if (is_debug(DEBUG_NODE)) {
             fprintf(fp, " : ");
-            fprint_type(fp, np->type);
+            fprint_type(fp, ast_type(ast, n));
             fprintf(fp, "\n");
         }
         break;
     case NK_CALL:
-        fprint_node(fp, 0, np->u.link.n1);
+        fprint_ast(cc, fp, 0, ast, ast_child(ast, n, 0));
         fprintf(fp, "(");
-        fprint_node(fp, 0, np->u.link.n2);
+        for (i = 1; i < ast_count(ast, n); i++) {
+            if (i > 1)
+                fprintf(fp, ", ");
+            fprint_ast(cc, fp, 0, ast, ast_child(ast, n, i));
+        }
         fprintf(fp, ")");
-        if (is_debug("node")) {
+        if (is_debug(DEBUG_NODE)) {
             fprintf(fp, " : ");
-            fprint_type(fp, np->type);
+            fprint_type(fp, ast_type(ast, n));
             fprintf(fp, "\n");
         }
         break;
-    case NK_ARG:
-        fprint_node(fp, 0, np->u.link.n1);
-        if (np->u.link.n2) {
-            fprintf(fp, ", ");
-            fprint_node(fp, 0, np->u.link.n2);
-        }
-        break;
+    default:
+        assert(0);
     }
 }
 
 
-void print_node(int indent, const NODE *np)
+/* the tree is printed from its compact copy */
+void fprint_node(COMPILER *cc, FILE *fp, int indent, const NODE *np)
+{
+    ARENA *a;
+    AST *ast;
+
+    if (np == NULL)
+        return;
+    a = new_arena(cc);
+    ast = new_ast(a, np);
+    fprint_ast(cc, fp, indent, ast, ast_root(ast));
+    free_arena(a);
+}
+
+void print_node(COMPILER *cc, int indent, const NODE *np)
 {
-    fprint_node(stdout, indent, np);
+    fprint_node(cc, stdout, indent, np);
 }
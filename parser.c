@@ -1,5 +1,9 @@
 #include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include <pthread.h>
 #include "mcc.h"
+#include "firsttab.h"
 
 #define COUNT_OF(array) (sizeof (array) / sizeof (array[0]))
 
@@ -8,77 +12,104 @@
 # define LEAVE(fn)      ((void) 0)
 # define TRACE(fn,s)    ((void) 0)
 #else
-static int s_indent = 0;
 # define ENTER(fn)  \
-        if (is_debug("parser_scope")) \
-            printf("%*sENTER %s\n", s_indent++, "", (fn))
+        if (is_debug(DEBUG_PARSER_SCOPE)) \
+            printf("%*sENTER %s\n", pars->cc->indent++, "", (fn))
 # define LEAVE(fn)  \
-        if (is_debug("parser_scope")) \
-            printf("%*sLEAVE %s\n", --s_indent, "", (fn))
+        if (is_debug(DEBUG_PARSER_SCOPE)) \
+            printf("%*sLEAVE %s\n", --pars->cc->indent, "", (fn))
 # define TRACE(fn, s)  \
-        if (is_debug("parser_scope")) \
-            printf("%*sTRACE %s: %s\n", s_indent, "", (fn), (s))
+        if (is_debug(DEBUG_PARSER_SCOPE)) \
+            printf("%*sTRACE %s: %s\n", pars->cc->indent, "", (fn), (s))
 #endif
 
-#ifdef NDEBUG
-#define next(pars)  ((pars)->token = next_token((pars)->scan))
-#else
-static TOKEN next(PARSER *pars)
+/* make tokens[i] available, false past the end of a prelexed stream */
+static bool fill_tokens(PARSER *pars, size_t i)
 {
-    pars->token = next_token(pars->scan);
-    if (is_debug("parser")) {
-        printf("%s(%d): %s\n",
-            pars->scan->pos.filename, pars->scan->pos.line,
-            scan_token_to_string(pars->scan, pars->token));
+    while (i >= pars->tokens->count) {
+        if (pars->prelexed)
+            return false;
+        lex_token(pars->tokens, pars->scan);
     }
-    return pars->token;
+    return true;
 }
-#endif
 
-static const POS *get_pos(const PARSER *pars)
+static TOKEN next(PARSER *pars)
 {
-    return &pars->scan->pos;
+    TOKEN_STREAM *ts = pars->tokens;
+    size_t i;
+
+    if (!pars->prelexed && pars->next == ts->count) {
+        ts->count = 0;      /* all consumed, reuse the buffer */
+        pars->next = 0;
+    }
+    i = pars->next;
+    if (fill_tokens(pars, i))
+        pars->next++;
+    else
+        i = ts->count - 1;  /* stay on TK_EOF */
+    pars->token = ts->kind[i];
+    pars->loc = ts->loc[i];
+
+    if (is_debug(DEBUG_PARSER)) {
+        POS pos = decode_loc(pars->cc, pars->loc);
+        printf("%s(%d): ", pos.filename, pos.line);
+        fprint_token(pars->cc, stdout, ts, i);
+        printf("\n");
+    }
+    return pars->token;
 }
 
-static POS copy_pos(const PARSER *pars)
+/* k-th token after the current one; peek(pars, 0) is pars->token */
+static TOKEN peek(PARSER *pars, int k)
 {
-    return pars->scan->pos;
+    size_t i = pars->next - 1 + k;
+    if (!fill_tokens(pars, i))
+        return TK_EOF;
+    return pars->tokens->kind[i];
 }
 
 static char *get_id(PARSER *pars)
 {
     assert(pars->token == TK_ID);
-    return pars->scan->id;
+    return ident_string(pars->cc, pars->tokens->value[pars->next - 1]);
 }
 
 static int get_int_lit(PARSER *pars)
 {
     assert(pars->token == TK_INT_LIT);
-    return pars->scan->num;
+    return (int) pars->tokens->value[pars->next - 1];
 }
 
-PARSER *open_parser_text(const char *filename, const char *text)
+static PARSER *new_parser(COMPILER *cc, SCANNER *scan)
 {
-    PARSER *pars = (PARSER*) alloc(sizeof (PARSER));
-    pars->scan = open_scanner_text(filename, text);
-    if (pars->scan == NULL) {
-        close_parser(pars);
+    PARSER *pars;
+    if (scan == NULL)
         return NULL;
-    }
+    pars = (PARSER*) alloc(sizeof (PARSER));
+    pars->cc = cc;
+    pars->scan = scan;
+    pars->tokens = new_token_stream(loc_filename(cc, scan->base));
+    pars->next = 0;
+    pars->prelexed = false;
     pars->token = TK_EOF;
+    pars->loc = scan->base;
+    pars->recover = NULL;
+    pars->pch = NULL;
+    pars->lazy = false;
+    pars->skipped = NULL;
+    pars->n_skipped = pars->skipped_size = 0;
     return pars;
 }
 
-PARSER *open_parser(const char *filename)
+PARSER *open_parser_text(COMPILER *cc, const char *filename, const char *text)
 {
-    PARSER *pars = (PARSER*) alloc(sizeof (PARSER));
-    pars->scan = open_scanner(filename);
-    if (pars->scan == NULL) {
-        close_parser(pars);
-        return NULL;
-    }
-    pars->token = TK_EOF;
-    return pars;
+    return new_parser(cc, open_scanner_text(cc, filename, text));
+}
+
+PARSER *open_parser(COMPILER *cc, const char *filename)
+{
+    return new_parser(cc, open_scanner(cc, filename));
 }
 
 bool close_parser(PARSER *pars)
@@ -87,25 +118,39 @@ bool close_parser(PARSER *pars)
         return false;
     if (!close_scanner(pars->scan))
         return false;
+    free_token_stream(pars->tokens);
+    free_pch(pars->pch);
+    free(pars->skipped);
     free(pars);
     return true;
 }
 
+/* lex the whole input up front, before parse() */
+void prelex(PARSER *pars)
+{
+    assert(pars->tokens->count == 0);
+    prescan(source_scanner(pars->scan));
+    lex_all(pars->tokens, pars->scan);
+    pars->prelexed = true;
+}
+
 static void parser_warning(PARSER *pars, const char *s, ...)
 {
     va_list ap;
     va_start(ap, s);
-    vwarning(&pars->scan->pos, s, ap);
+    vwarning(pars->cc, pars->loc, s, ap);
     va_end(ap);
 }
 
+/* goes on at the recovery point of the statement or declaration */
 static void parser_error(PARSER *pars, const char *s, ...)
 {
     va_list ap;
     va_start(ap, s);
-    verror(&pars->scan->pos, s, ap);
+    vreport_error(pars->cc, pars->loc, s, ap);
     va_end(ap);
-    exit(1);
+    longjmp(pars->recover != NULL ? *pars->recover : pars->cc->error_jmp_buf,
+            1);
 }
 
 static bool expect(PARSER *pars, TOKEN tk)
@@ -115,25 +160,101 @@ static bool expect(PARSER *pars, TOKEN tk)
         return true;
     }
     parser_error(pars,
-        "missing token %s", scan_token_to_string(pars->scan, tk));
+        "missing token %s", token_to_string(tk));
     return false;
 }
 
 
-static bool is_token_begin_with(PARSER *pars, TOKEN array[], int count)
+/*
+ * panic mode: after an error in a statement, skip to the ';' ending it,
+ * or past a block begun in it.  the '}' of the enclosing block is left.
+ */
+static void skip_statement(PARSER *pars)
 {
-    int i;
-    for (i = 0; i < count; i++)
-        if (pars->token == array[i])
-            return true;
-    return false;
+    int depth = 0;
+
+    for (;;) {
+        switch (pars->token) {
+        case TK_EOF:
+            return;
+        case TK_SEMI:
+            if (depth == 0) {
+                next(pars);
+                return;
+            }
+            break;
+        case TK_BEGIN:
+            depth++;
+            break;
+        case TK_END:
+            if (depth == 0)
+                return;
+            if (--depth == 0) {
+                next(pars);
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+        next(pars);
+    }
+}
+
+static bool is_declaration_specifier(PARSER *pars);
+
+/*
+ * the same after an error in a declaration, which may also end where
+ * the next declaration begins.  a stray '}' is skipped at the top level.
+ */
+static void skip_declaration(PARSER *pars, bool top)
+{
+    int depth = 0;
+
+    for (;;) {
+        switch (pars->token) {
+        case TK_EOF:
+            return;
+        case TK_SEMI:
+            if (depth == 0) {
+                next(pars);
+                return;
+            }
+            break;
+        case TK_BEGIN:
+            depth++;
+            break;
+        case TK_END:
+            if (depth == 0 && !top)
+                return;
+            if (depth == 0 || --depth == 0) {
+                next(pars);
+                return;
+            }
+            break;
+        default:
+            if (depth == 0 && is_declaration_specifier(pars))
+                return;
+            break;
+        }
+        next(pars);
+    }
+}
+
+/* tk can begin the nonterminal nt of the grammar */
+static bool is_first(int nt, TOKEN tk)
+{
+    return (s_grammar[nt].first[tk / 32] >> (tk % 32)) & 1;
+}
+
+static bool is_declaration_specifier_token(TOKEN tk)
+{
+    return is_first(NT_DECLARATION_SPECIFIERS, tk);
 }
 
 static bool is_declaration_specifier(PARSER *pars)
 {
-    static TOKEN begin_with[] = { TK_STATIC, TK_EXTERN,
-            TK_VOID, TK_INT, };
-    return is_token_begin_with(pars, begin_with, COUNT_OF(begin_with));
+    return is_declaration_specifier_token(pars->token);
 }
 
 static bool is_declaration(PARSER *pars)
@@ -143,24 +264,19 @@ static bool is_declaration(PARSER *pars)
 
 static bool is_expression(PARSER *pars)
 {
-    static TOKEN begin_with[] = { TK_AND, TK_STAR, TK_MINUS, TK_NOT, TK_ID,
-                    TK_INT_LIT, TK_LPAR};
-    return is_token_begin_with(pars, begin_with, COUNT_OF(begin_with));
+    return is_first(NT_EXPRESSION, pars->token);
 }
 
 static bool is_statement(PARSER *pars)
 {
-    static TOKEN begin_with[] = { TK_BEGIN, TK_IF, TK_WHILE, TK_FOR,
-            TK_WHILE, TK_FOR, TK_CONTINUE, TK_BREAK, TK_RETURN };
-    if (is_expression(pars))
-        return true;
-    return is_token_begin_with(pars, begin_with, COUNT_OF(begin_with));
+    return is_first(NT_STATEMENT, pars->token);
 }
 
+/* the grammar has unary '+' and '~', the parser not yet */
 static bool is_unary_operator(PARSER *pars)
 {
-    static TOKEN begin_with[] = { TK_AND, TK_STAR, TK_MINUS, TK_NOT };
-    return is_token_begin_with(pars, begin_with, COUNT_OF(begin_with));
+    return is_first(NT_UNARY_OPERATOR, pars->token)
+        && pars->token != TK_PLUS && pars->token != TK_TILDE;
 }
 
 static NODE_KIND unary_token_to_node_kind(TOKEN tok)
@@ -175,22 +291,143 @@ static NODE_KIND unary_token_to_node_kind(TOKEN tok)
     return NK_EXPR;
 }
 
-static NODE_KIND token_to_node_kind(TOKEN tok)
+/*
+ * constant folding
+ * an operator whose operands are integer constants is replaced by its
+ * value as the node is built, so a folded operand folds its parent in
+ * turn.  the arithmetic is done in long long and the result wrapped to
+ * int, with a warning when it does not fit; a division by zero is left
+ * for run time.  a few identities are also simplified: x+0, x-0, x*1,
+ * x/1 and !!c, but not down to a variable, which would then take an
+ * assignment or '&'.
+ */
+static bool is_int_lit(const NODE *np, int num)
 {
-    switch (tok) {
-    case TK_EQ:     return NK_EQ;
-    case TK_NEQ:    return NK_NEQ;
-    case TK_LT:     return NK_LT;
-    case TK_GT:     return NK_GT;
-    case TK_LE:     return NK_LE;
-    case TK_GE:     return NK_GE;
-    case TK_PLUS:   return NK_ADD;
-    case TK_MINUS:  return NK_SUB;
-    case TK_STAR:   return NK_MUL;
-    case TK_SLASH:  return NK_DIV;
-    default:        assert(0);
+    return (np != NULL && np->kind == NK_INT_LIT && np->u.num == num);
+}
+
+/* operators whose value is 0 or 1 */
+static bool is_boolean(const NODE *np)
+{
+    switch (np->kind) {
+    case NK_EQ:
+    case NK_NEQ:
+    case NK_LT:
+    case NK_GT:
+    case NK_LE:
+    case NK_GE:
+    case NK_LAND:
+    case NK_LOR:
+    case NK_NOT:
+        return true;
+    default:
+        return false;
     }
-    return NK_EXPR;
+}
+
+static NODE *new_int_lit(PARSER *pars, SRCLOC loc, long long num)
+{
+    if (num < INT_MIN || num > INT_MAX) {
+        parser_warning(pars, "integer overflow in expression");
+        num = (int) (unsigned) num;
+    }
+    return new_node_int(pars->cc, NK_INT_LIT, loc, (int) num);
+}
+
+/* np != 0, as an int */
+static NODE *new_test(PARSER *pars, SRCLOC loc, NODE *np)
+{
+    if (is_boolean(np))
+        return np;
+    return new_node2(pars->cc, NK_NEQ, loc, &g_type_int, np,
+                     new_node_int(pars->cc, NK_INT_LIT, loc, 0));
+}
+
+static NODE *fold_unary(PARSER *pars, NODE_KIND kind, SRCLOC loc,
+                        TYPE *typ, NODE *np)
+{
+    if (np->kind == NK_INT_LIT) {
+        switch (kind) {
+        case NK_MINUS:
+            return new_int_lit(pars, loc, -(long long) np->u.num);
+        case NK_NOT:
+            return new_int_lit(pars, loc, !np->u.num);
+        default:
+            break;
+        }
+    }
+    if (kind == NK_NOT && np->kind == NK_NOT)
+        return new_test(pars, loc, np->u.link.n1);
+    return new_node1(pars->cc, kind, loc, typ, np);
+}
+
+/* np as the value of an identity, NULL when it is not one to drop to */
+static NODE *drop_to(NODE *np)
+{
+    return node_can_take_addr(np) ? NULL : np;
+}
+
+static NODE *fold_binary(PARSER *pars, NODE_KIND kind, SRCLOC loc,
+                         TYPE *typ, NODE *lhs, NODE *rhs)
+{
+    long long l, r;
+
+    if (kind == NK_DIV && is_int_lit(rhs, 0)) {
+        parser_warning(pars, "division by zero");
+        return new_node2(pars->cc, kind, loc, typ, lhs, rhs);
+    }
+    if (lhs->kind == NK_INT_LIT && rhs->kind == NK_INT_LIT) {
+        l = lhs->u.num;
+        r = rhs->u.num;
+        switch (kind) {
+        case NK_ADD:    return new_int_lit(pars, loc, l + r);
+        case NK_SUB:    return new_int_lit(pars, loc, l - r);
+        case NK_MUL:    return new_int_lit(pars, loc, l * r);
+        case NK_DIV:    return new_int_lit(pars, loc, l / r);
+        case NK_EQ:     return new_int_lit(pars, loc, l == r);
+        case NK_NEQ:    return new_int_lit(pars, loc, l != r);
+        case NK_LT:     return new_int_lit(pars, loc, l < r);
+        case NK_GT:     return new_int_lit(pars, loc, l > r);
+        case NK_LE:     return new_int_lit(pars, loc, l <= r);
+        case NK_GE:     return new_int_lit(pars, loc, l >= r);
+        case NK_LAND:   return new_int_lit(pars, loc, l && r);
+        case NK_LOR:    return new_int_lit(pars, loc, l || r);
+        default:
+            break;
+        }
+    }
+    /* the right operand of && and || is not evaluated past a constant */
+    if (lhs->kind == NK_INT_LIT && (kind == NK_LAND || kind == NK_LOR)) {
+        if ((lhs->u.num != 0) == (kind == NK_LOR))
+            return new_int_lit(pars, loc, kind == NK_LOR);
+        return new_test(pars, loc, rhs);
+    }
+    if (type_is_int(lhs->type) && type_is_int(rhs->type)) {
+        NODE *np = NULL;
+        switch (kind) {
+        case NK_ADD:
+            if (is_int_lit(lhs, 0))
+                np = drop_to(rhs);
+            /* FALLTHROUGH */
+        case NK_SUB:
+            if (np == NULL && is_int_lit(rhs, 0))
+                np = drop_to(lhs);
+            break;
+        case NK_MUL:
+            if (is_int_lit(lhs, 1))
+                np = drop_to(rhs);
+            /* FALLTHROUGH */
+        case NK_DIV:
+            if (np == NULL && is_int_lit(rhs, 1))
+                np = drop_to(lhs);
+            break;
+        default:
+            break;
+        }
+        if (np != NULL)
+            return np;
+    }
+    return new_node2(pars->cc, kind, loc, typ, lhs, rhs);
 }
 
 static NODE *parse_expression(PARSER *pars);
@@ -214,13 +451,13 @@ static NODE *parse_primary_expression(PARSER *pars)
         {
             SYMBOL *sym;
             char *id = get_id(pars);
-            sym = lookup_symbol(id);
+            sym = lookup_symbol(pars->cc, id);
             if (sym == NULL) {
                 parser_error(pars, "undefined symbol '%s'", id);
             }
-            np = new_node_sym(NK_ID, get_pos(pars), sym);
+            np = new_node_sym(pars->cc, NK_ID, pars->loc, sym);
             next(pars);
-            if (is_debug("parser")) {
+            if (is_debug(DEBUG_PARSER)) {
                 printf("sym:%s:", id);
                 print_type(sym->type);
                 printf("\n");
@@ -231,7 +468,7 @@ static NODE *parse_primary_expression(PARSER *pars)
         TRACE("parse_primary_expression", "INT_LIT");
         {
             int n = get_int_lit(pars);
-            np = new_node_int(NK_INT_LIT, get_pos(pars), n);
+            np = new_node_int(pars->cc, NK_INT_LIT, pars->loc, n);
             next(pars);
         }
         break;
@@ -261,9 +498,9 @@ static NODE *parse_argument_expression_list(PARSER *pars)
     ENTER("parse_argument_expression_list");
     np = parse_assignment_expression(pars);
     while (pars->token == TK_COMMA) {
-        POS pos = copy_pos(pars);
+        SRCLOC loc = pars->loc;
         next(pars);
-        np = new_node2(NK_ARG, &pos, NULL,
+        np = new_node2(pars->cc, NK_ARG, loc, NULL,
                         np, parse_assignment_expression(pars));
     }
     LEAVE("parse_argument_expression_list");
@@ -282,7 +519,7 @@ static NODE *parse_postfix_expression(PARSER *pars)
     np = parse_primary_expression(pars);
     if (pars->token == TK_LPAR) {
         NODE *a;
-        POS pos = copy_pos(pars);
+        SRCLOC loc = pars->loc;
         next(pars);
         if (pars->token != TK_RPAR) {
             a = parse_argument_expression_list(pars);
@@ -292,7 +529,7 @@ static NODE *parse_postfix_expression(PARSER *pars)
         expect(pars, TK_RPAR);
         if (!type_is_function(np->type))
             parser_error(pars, "not function call");
-        np = new_node2(NK_CALL, &pos,
+        np = new_node2(pars->cc, NK_CALL, loc,
                         get_func_return_type(np->type), np, a);
     }
     LEAVE("parse_postfix_expression");
@@ -308,36 +545,34 @@ static NODE *parse_unary_expression(PARSER *pars)
 {
     NODE *np;
     NODE_KIND kind = NK_EXPR;
-    POS pos = copy_pos(pars);
+    SRCLOC loc = pars->loc;
     ENTER("parse_unary_expression");
     if (is_unary_operator(pars)) {
         kind = unary_token_to_node_kind(pars->token);
         next(pars);
     }
-    np = parse_postfix_expression(pars);
+    if (kind != NK_EXPR)
+        np = parse_unary_expression(pars);
+    else
+        np = parse_postfix_expression(pars);
     switch (kind) {
     case NK_ADDR:
         if (!node_can_take_addr(np))
             parser_error(pars, "cannot take the address");
-        np = new_node1(NK_ADDR, &pos,
-                        new_type(T_POINTER, np->type, NULL), np);
+        np = new_node1(pars->cc, NK_ADDR, loc,
+                        new_type(pars->cc, T_POINTER, np->type, NULL), np);
         break;
     case NK_INDIR:
         if (!type_is_pointer(np->type))
             parser_error(pars, "cannot indirection");
-        np = new_node1(NK_INDIR, &pos,
+        np = new_node1(pars->cc, NK_INDIR, loc,
                         type_indir(np->type), np);
         break;
     case NK_MINUS:
-        if (!type_is_int(np->type))
-            parser_error(pars, "invalid type to unary");
-        np = new_node1(NK_MINUS, &pos,
-                        &g_type_int, np);
     case NK_NOT:
         if (!type_is_int(np->type))
             parser_error(pars, "invalid type to unary");
-        np = new_node1(NK_NOT, &pos,
-                        &g_type_int, np);
+        np = fold_unary(pars, kind, loc, &g_type_int, np);
         break;
     case NK_EXPR:
         break;
@@ -394,7 +629,7 @@ static TYPE *type_check_bin(PARSER *pars, NODE_KIND kind, TYPE *lhs, TYPE *rhs)
     default: assert(0);
     }
 
-    if (is_debug("parser")) {
+    if (is_debug(DEBUG_PARSER)) {
         printf("lhs:"); print_type(lhs); printf("\n");
         printf("rhs:"); print_type(rhs); printf("\n");
     }
@@ -403,178 +638,84 @@ static TYPE *type_check_bin(PARSER *pars, NODE_KIND kind, TYPE *lhs, TYPE *rhs)
 }
 
 /*
+ * binary operators by token, power 0 for any other token.  a binary
+ * expression is parsed by precedence climbing: the operand is parsed,
+ * then each operator that binds at least as tightly as the caller asked
+ * for takes it as its left operand, and parses its right one at the next
+ * higher power (at its own for '=', which groups right to left).
+ *
+assignment_expression
+	= logical_or_expression
+	| unary_expression '=' assignment_expression
+logical_or_expression
+	= logical_and_expression
+	| logical_or_expression '||' logical_and_expression
+logical_and_expression
+	= equality_expression
+	| logical_and_expression '&&' equality_expression
+equality_expression
+	= relational_expression
+	| equality_expression ('==' | '!=') relational_expression
+relational_expression
+	= additive_expression
+	| relational_expression ('<' | '>' | '<=' | '>=') additive_expression
+additive_expression
+	= multiplicative_expression
+	| additive_expression ('+' | '-') multiplicative_expression
 multiplicative_expression
 	= unary_expression
-	| multiplicative_expression '*' cast_expression
-	| multiplicative_expression '/' cast_expression
-*/
-static NODE *parse_multiplicative_expression(PARSER *pars)
+	| multiplicative_expression ('*' | '/') unary_expression
+ */
+static const struct {
+    NODE_KIND kind;
+    unsigned char power;
+} s_binary_ops[TK_COUNT] = {
+    [TK_ASSIGN] = { NK_ASSIGN,  1 },
+    [TK_LOR]    = { NK_LOR,     2 },
+    [TK_LAND]   = { NK_LAND,    3 },
+    [TK_EQ]     = { NK_EQ,      4 },
+    [TK_NEQ]    = { NK_NEQ,     4 },
+    [TK_LT]     = { NK_LT,      5 },
+    [TK_GT]     = { NK_GT,      5 },
+    [TK_LE]     = { NK_LE,      5 },
+    [TK_GE]     = { NK_GE,      5 },
+    [TK_PLUS]   = { NK_ADD,     6 },
+    [TK_MINUS]  = { NK_SUB,     6 },
+    [TK_STAR]   = { NK_MUL,     7 },
+    [TK_SLASH]  = { NK_DIV,     7 },
+};
+
+#define POWER_ASSIGN    1
+
+static NODE *parse_binary_expression(PARSER *pars, int min_power)
 {
     NODE *np;
-    ENTER("parse_multiplicative_expression");
+    int power;
+    ENTER("parse_binary_expression");
     np = parse_unary_expression(pars);
-    while (pars->token == TK_STAR || pars->token == TK_SLASH) {
-        NODE_KIND kind = token_to_node_kind(pars->token);
-        NODE *rhs;
-        TYPE *typ;
-        POS pos = copy_pos(pars);
-        next(pars);
-        rhs = parse_unary_expression(pars);
-        typ = type_check_bin(pars, kind, np->type, rhs->type);
-        np = new_node2(kind, &pos, typ, np, rhs);
-    }
-    LEAVE("parse_multiplicative_expression");
-    return np;
-}
-
-/*
-additive_expression
-	= multiplicative_expression
-	| additive_expression '+' multiplicative_expression
-	| additive_expression '-' multiplicative_expression
-*/
-static NODE *parse_additive_expression(PARSER *pars)
-{
-    NODE *np;
-    ENTER("parse_additive_expression");
-    np = parse_multiplicative_expression(pars);
-    while (pars->token == TK_PLUS || pars->token == TK_MINUS) {
-        NODE_KIND kind = token_to_node_kind(pars->token);
-        NODE *rhs;
-        TYPE *typ;
-        POS pos = copy_pos(pars);
-        next(pars);
-        rhs = parse_multiplicative_expression(pars);
-        typ = type_check_bin(pars, kind, np->type, rhs->type);
-        np = new_node2(kind, &pos, typ, np, rhs);
-    }
-    LEAVE("parse_additive_expression");
-    return np;
-}
-
-/*
-relational_expression
-	= additive_expression
-	| relational_expression '<' additive_expression
-	| relational_expression '>' additive_expression
-	| relational_expression '<=' additive_expression
-	| relational_expression '>=' additive_expression
-*/
-static NODE *parse_relational_expression(PARSER *pars)
-{
-    NODE *np;
-    ENTER("parse_relational_expression");
-    np = parse_additive_expression(pars);
-    while (pars->token == TK_LT || pars->token == TK_GT ||
-            pars->token == TK_LE || pars->token == TK_GE) {
-        NODE_KIND kind = token_to_node_kind(pars->token);
-        NODE *rhs;
-        TYPE *typ;
-        POS pos = copy_pos(pars);
-        next(pars);
-        rhs = parse_additive_expression(pars);
-        typ = type_check_bin(pars, kind, np->type, rhs->type);
-        np = new_node2(kind, &pos, typ, np, rhs);
-    }
-    LEAVE("parse_relational_expression");
-    return np;
-}
-
-/*
-equality_expression
-	= relational_expression
-	| equality_expression '==' relational_expression
-	| equality_expression '!=' relational_expression
-*/
-static NODE *parse_equality_expression(PARSER *pars)
-{
-    NODE *np;
-    ENTER("parse_equality_expression");
-    np = parse_relational_expression(pars);
-    while (pars->token == TK_EQ || pars->token == TK_NEQ) {
-        NODE_KIND kind = token_to_node_kind(pars->token);
+    while ((power = s_binary_ops[pars->token].power) >= min_power
+            && power > 0) {
+        NODE_KIND kind = s_binary_ops[pars->token].kind;
         NODE *rhs;
         TYPE *typ;
-        POS pos = copy_pos(pars);
+        SRCLOC loc = pars->loc;
         next(pars);
-        rhs = parse_relational_expression(pars);
+        if (kind == NK_ASSIGN) {
+            if (np->kind != NK_ID)
+                parser_error(pars, "invalid left value");
+            rhs = parse_binary_expression(pars, power);
+        } else
+            rhs = parse_binary_expression(pars, power + 1);
         typ = type_check_bin(pars, kind, np->type, rhs->type);
-        np = new_node2(kind, &pos, typ, np, rhs);
+        np = fold_binary(pars, kind, loc, typ, np, rhs);
     }
-    LEAVE("parse_equality_expression");
+    LEAVE("parse_binary_expression");
     return np;
 }
 
-/*
-logical_and_expression
-	= equality_expression
-	| logical_and_expression '&&' inclusive_or_expression
-*/
-static NODE *parse_logical_and_expression(PARSER *pars)
-{
-    NODE *np;
-    ENTER("parse_logical_and_expression");
-    np = parse_equality_expression(pars);
-    while (pars->token == TK_LAND) {
-        NODE *rhs;
-        TYPE *typ;
-        POS pos = copy_pos(pars);
-        next(pars);
-        rhs = parse_equality_expression(pars);
-        typ = type_check_bin(pars, NK_LAND, np->type, rhs->type);
-        np = new_node2(NK_LAND, &pos, typ, np, rhs);
-    }
-    LEAVE("parse_logical_and_expression");
-    return np;
-}
-
-/*
-logical_or_expression
-	= logical_and_expression
-	| logical_or_expression '||' logical_and_expression
-*/
-static NODE *parse_logical_or_expression(PARSER *pars)
-{
-    NODE *np;
-    ENTER("parse_logical_or_expression");
-    np = parse_logical_and_expression(pars);
-    while (pars->token == TK_LOR) {
-        NODE *rhs;
-        TYPE *typ;
-        POS pos = copy_pos(pars);
-        next(pars);
-        rhs = parse_logical_and_expression(pars);
-        typ = type_check_bin(pars, NK_LOR, np->type, rhs->type);
-        np = new_node2(NK_LOR, &pos, typ, np, rhs);
-    }
-    LEAVE("parse_logical_or_expression");
-    return np;
-}
-
-
-/*
-assignment_expression
-	= logical_or_expression
-	| unary_expression '=' assignment_expression
-*/
 static NODE *parse_assignment_expression(PARSER *pars)
 {
-    NODE *np;
-    ENTER("parse_assignment_expression");
-    np = parse_logical_or_expression(pars);
-    if (pars->token == TK_ASSIGN) {
-        NODE *rhs;
-        TYPE *typ;
-        POS pos = copy_pos(pars);
-        next(pars);
-        if (np->kind != NK_ID)
-            parser_error(pars, "invalid left value");
-        rhs = parse_assignment_expression(pars);
-        typ = type_check_bin(pars, NK_ASSIGN, np->type, rhs->type);
-        np = new_node2(NK_ASSIGN, &pos, typ, np, rhs);
-    }
-    LEAVE("parse_assignment_expression");
-    return np;
+    return parse_binary_expression(pars, POWER_ASSIGN);
 }
 
 /*
@@ -593,6 +734,22 @@ static NODE *parse_expression(PARSER *pars)
 static void parse_declaration(PARSER *pars, int *var_num);
 static NODE *parse_statement(PARSER *pars);
 
+/* a declaration at the top of a block, skipped after an error */
+static void parse_block_declaration(PARSER *pars, int *var_num)
+{
+    jmp_buf recover, *outer = pars->recover;
+    SYMTAB *scope = get_scope(pars->cc);
+
+    if (setjmp(recover) == 0) {
+        pars->recover = &recover;
+        parse_declaration(pars, var_num);
+    } else {
+        set_scope(pars->cc, scope);
+        skip_declaration(pars, false);
+    }
+    pars->recover = outer;
+}
+
 /*
 compound_statement
 	= '{' [declaration_list] {statement} '}'
@@ -601,18 +758,29 @@ declaration_list
 */
 static NODE *parse_compound_statement(PARSER *pars, int var_num)
 {
-    NODE *np = new_node(NK_COMPOUND, get_pos(pars), NULL);
+    NODE *np = new_node(pars->cc, NK_COMPOUND, pars->loc, NULL);
+    unsigned size = 0;
 
     ENTER("parse_compound_statement");
 
+    np->u.comp.stmt = NULL;
+    np->u.comp.count = 0;
     next(pars); /* skip '{' */
     while (is_declaration(pars))
-        parse_declaration(pars, &var_num);
-    while (is_statement(pars)) {
-        NODE *p;
-        POS pos = copy_pos(pars);
-        p = parse_statement(pars);
-        np->u.comp.left = link_node(NK_LINK, &pos, p, np->u.comp.left);
+        parse_block_declaration(pars, &var_num);
+    while (pars->token != TK_END && pars->token != TK_EOF) {
+        NODE *p = parse_statement(pars);
+        if (p == NULL)
+            continue;
+        /* grown in the arena; the old vectors go with the body */
+        if (np->u.comp.count == size) {
+            NODE **stmt;
+            size = size ? size * 2 : 8;
+            stmt = (NODE**) new_object(pars->cc, size * sizeof (NODE*));
+            memcpy(stmt, np->u.comp.stmt, np->u.comp.count * sizeof (NODE*));
+            np->u.comp.stmt = stmt;
+        }
+        np->u.comp.stmt[np->u.comp.count++] = p;
     }
     expect(pars, TK_END);
     LEAVE("parse_compound_statement");
@@ -648,7 +816,7 @@ jump_statement
 	| RETURN [expression] ';'
 
 */
-static NODE *parse_statement(PARSER *pars)
+static NODE *parse_statement_1(PARSER *pars)
 {
     NODE *np = NULL;
     SYMTAB *tab;
@@ -657,17 +825,17 @@ static NODE *parse_statement(PARSER *pars)
     switch (pars->token) {
     case TK_BEGIN:
         TRACE("parse_statement", "compound");
-        tab = enter_scope();
-        np = parse_compound_statement(pars, get_func_var_num() + 1);
+        tab = enter_scope(pars->cc);
+        np = parse_compound_statement(pars, get_func_var_num(pars->cc) + 1);
         assert(np->kind == NK_COMPOUND);
         np->u.comp.symtab = tab;
-        leave_scope();
+        leave_scope(pars->cc);
         break;
     case TK_IF:
         TRACE("parse_statement", "if");
         {
             NODE *c, *s, *e;
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             next(pars);
             expect(pars, TK_LPAR);
             c = parse_expression(pars);
@@ -678,27 +846,27 @@ static NODE *parse_statement(PARSER *pars)
                 e = parse_statement(pars);
             } else
                 e = NULL;
-            np = new_node3(NK_IF, &pos, NULL, c, s, e);
+            np = new_node3(pars->cc, NK_IF, loc, NULL, c, s, e);
         }
         break;
     case TK_WHILE:
         TRACE("parse_statement", "while");
         {
             NODE *c, *b;
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             next(pars);
             expect(pars, TK_LPAR);
             c = parse_expression(pars);
             expect(pars, TK_RPAR);
             b = parse_statement(pars);
-            np = new_node2(NK_WHILE, &pos, NULL, c, b);
+            np = new_node2(pars->cc, NK_WHILE, loc, NULL, c, b);
         }
         break;
     case TK_FOR:
         TRACE("parse_statement", "for");
         {
             NODE *e1, *e2, *e3, *b;
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             next(pars);
             expect(pars, TK_LPAR);
             if (is_expression(pars))
@@ -717,52 +885,52 @@ static NODE *parse_statement(PARSER *pars)
                 e3 = NULL;
             expect(pars, TK_RPAR);
             b = parse_statement(pars);
-            np = new_node4(NK_FOR, &pos, NULL, e1, e2, e3, b);
+            np = new_node4(pars->cc, NK_FOR, loc, NULL, e1, e2, e3, b);
         }
         break;
     case TK_CONTINUE:
         TRACE("parse_statement", "continue");
         {
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             next(pars);
             expect(pars, TK_SEMI);
-            np = new_node(NK_CONTINUE, &pos, NULL);
+            np = new_node(pars->cc, NK_CONTINUE, loc, NULL);
         }
         break;
     case TK_BREAK:
         TRACE("parse_statement", "break");
         {
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             next(pars);
             expect(pars, TK_SEMI);
-            np = new_node(NK_BREAK, &pos, NULL);
+            np = new_node(pars->cc, NK_BREAK, loc, NULL);
         }
         break;
     case TK_RETURN:
         TRACE("parse_statement", "return");
         {
             NODE *e;
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             next(pars);
             if (is_expression(pars))
                 e = parse_expression(pars);
             else
                 e = NULL;
             expect(pars, TK_SEMI);
-            np = new_node1(NK_RETURN, &pos, e ? e->type : NULL, e);
+            np = new_node1(pars->cc, NK_RETURN, loc, e ? e->type : NULL, e);
         }
         break;
     default:
         TRACE("parse_statement", "expression");
         {
             NODE *e;
-            POS pos = copy_pos(pars);
+            SRCLOC loc = pars->loc;
             if (pars->token != TK_SEMI)
                 e = parse_expression(pars);
             else
                 e = NULL;
             expect(pars, TK_SEMI);
-            np = new_node1(NK_EXPR, &pos, NULL, e);
+            np = new_node1(pars->cc, NK_EXPR, loc, NULL, e);
         }
         break;
     }
@@ -770,8 +938,42 @@ static NODE *parse_statement(PARSER *pars)
     return np;
 }
 
+/* NULL for a statement that was skipped after an error */
+static NODE *parse_statement(PARSER *pars)
+{
+    jmp_buf recover, *outer = pars->recover;
+    SYMTAB *scope = get_scope(pars->cc);
+    NODE *np = NULL;
+
+    if (setjmp(recover) == 0) {
+        pars->recover = &recover;
+        if (!is_statement(pars))
+            parser_error(pars, "syntax error (statement)");
+        np = parse_statement_1(pars);
+    } else {
+        set_scope(pars->cc, scope);
+        skip_statement(pars);
+    }
+    pars->recover = outer;
+    return np;
+}
+
 static PARAM *parse_parameter_list(PARSER *pars);
 
+/*
+ * the type of '(' declarator ')' is made before the type it applies to,
+ * with T_UNKNOWN in its place.  types can't be changed once made, so
+ * the chain down to it is made again.
+ */
+static TYPE *complete_type(COMPILER *cc, TYPE *typ, TYPE *inner)
+{
+    assert(typ);
+    if (typ->kind == T_UNKNOWN)
+        return inner;
+    return new_type(cc, typ->kind, complete_type(cc, typ->type, inner),
+                    typ->param);
+}
+
 /*
 param_declarator
 	= {'*'} [IDENTIFIER | '(' param_declarator ')']
@@ -788,14 +990,16 @@ static void parse_param_declarator(PARSER *pars, TYPE **pptyp, char **id)
     assert(*pptyp);
 
     while (pars->token == TK_STAR) {
-        *pptyp = new_type(T_POINTER, *pptyp, NULL);
+        *pptyp = new_type(pars->cc, T_POINTER, *pptyp, NULL);
         next(pars);
     }
     if (pars->token == TK_ID) {
         *id = get_id(pars);
         next(pars);
-    } else if (pars->token == TK_LPAR) {
-        typ = new_type(T_UNKNOWN, NULL, NULL);
+    } else if (pars->token == TK_LPAR && peek(pars, 1) != TK_RPAR
+                && !is_declaration_specifier_token(peek(pars, 1))) {
+        /* '(' not starting a parameter list */
+        typ = new_type(pars->cc, T_UNKNOWN, NULL, NULL);
         next(pars);
         parse_param_declarator(pars, &typ, id);
         expect(pars, TK_RPAR);
@@ -806,22 +1010,9 @@ static void parse_param_declarator(PARSER *pars, TYPE **pptyp, char **id)
             param_list = parse_parameter_list(pars);
         }
         expect(pars, TK_RPAR);
-        *pptyp = new_type(T_FUNC, *pptyp, param_list);
-        if (typ) {
-            TYPE *p = typ;
-            while (p && p->type && p->type->kind != T_UNKNOWN)
-                p = p->type;
-            if (p->type) {
-                if (p->type->kind == T_UNKNOWN) {
-                    p->type = *pptyp;
-                    *pptyp = typ;
-                } else {
-                    assert(0);
-                }
-            } else {
-                assert(0);
-            }
-        }
+        *pptyp = new_type(pars->cc, T_FUNC, *pptyp, param_list);
+        if (typ)
+            *pptyp = complete_type(pars->cc, typ, *pptyp);
     } else if (typ) {
         /*TODO*/
         parser_error(pars, "syntax error (mcc)");
@@ -830,8 +1021,7 @@ static void parse_param_declarator(PARSER *pars, TYPE **pptyp, char **id)
     LEAVE("parse_param_declarator");
 }
 
-static void
-parse_declaration_specifiers(PARSER *pars, STORAGE_CLASS *sc, TYPE *typ);
+static TYPE *parse_declaration_specifiers(PARSER *pars, STORAGE_CLASS *sc);
 
 /*
 parameter_declaration
@@ -844,9 +1034,8 @@ static TYPE *parse_parameter_declaration(PARSER *pars, char **id)
 
     ENTER("parse_parameter_declaration");
 
-    typ = new_type(T_UNKNOWN, NULL, NULL);
     sc = SC_DEFAULT;
-    parse_declaration_specifiers(pars, &sc, typ);
+    typ = parse_declaration_specifiers(pars, &sc);
     /* TODO check sc */
 
     if (pars->token != TK_COMMA && pars->token != TK_RPAR)
@@ -868,11 +1057,11 @@ static PARAM *parse_parameter_list(PARSER *pars)
 
     ENTER("parse_parameter_list");
     typ = parse_parameter_declaration(pars, &id);
-    param_list = link_param(NULL, typ, id);
+    param_list = link_param(pars->cc, NULL, typ, id);
     while (pars->token == TK_COMMA) {
         next(pars);
         typ = parse_parameter_declaration(pars, &id);
-        param_list = link_param(param_list, typ, id);
+        param_list = link_param(pars->cc, param_list, typ, id);
     }
     LEAVE("parse_parameter_list");
     return param_list;
@@ -895,14 +1084,14 @@ static PARAM *parse_declarator(PARSER *pars, TYPE **pptyp, char **id)
     assert(id);
 
     while (pars->token == TK_STAR) {
-        *pptyp = new_type(T_POINTER, *pptyp, NULL);
+        *pptyp = new_type(pars->cc, T_POINTER, *pptyp, NULL);
         next(pars);
     }
     if (pars->token == TK_ID) {
         *id = get_id(pars);
         next(pars);
     } else if (pars->token == TK_LPAR) {
-        typ = new_type(T_UNKNOWN, NULL, NULL);
+        typ = new_type(pars->cc, T_UNKNOWN, NULL, NULL);
         next(pars);
         param_list = parse_declarator(pars, &typ, id);
         expect(pars, TK_RPAR);
@@ -915,22 +1104,9 @@ static PARAM *parse_declarator(PARSER *pars, TYPE **pptyp, char **id)
             param_list = parse_parameter_list(pars);
         }
         expect(pars, TK_RPAR);
-        *pptyp = new_type(T_FUNC, *pptyp, param_list);
-        if (typ) {
-            TYPE *p = typ;
-            while (p && p->type && p->type->kind != T_UNKNOWN)
-                p = p->type;
-            if (p->type) {
-                if (p->type->kind == T_UNKNOWN) {
-                    p->type = *pptyp;
-                    *pptyp = typ;
-                } else {
-                    assert(0);
-                }
-            } else {
-                assert(0);
-            }
-        }
+        *pptyp = new_type(pars->cc, T_FUNC, *pptyp, param_list);
+        if (typ)
+            *pptyp = complete_type(pars->cc, typ, *pptyp);
     } else if (typ) {
         /*TODO*/
         parser_error(pars, "syntax error (mcc)");
@@ -948,7 +1124,7 @@ type_specifier
 	= VOID | INT
 */
 static void
-parse_declaration_specifier(PARSER *pars, STORAGE_CLASS* sc, TYPE *typ)
+parse_declaration_specifier(PARSER *pars, STORAGE_CLASS* sc, TYPE_KIND *kind)
 {
     ENTER("parse_declaration_specifier");
     switch (pars->token) {
@@ -965,15 +1141,15 @@ parse_declaration_specifier(PARSER *pars, STORAGE_CLASS* sc, TYPE *typ)
         next(pars);
         break;
     case TK_VOID:
-        if (typ->kind != T_UNKNOWN)
+        if (*kind != T_UNKNOWN)
             parser_error(pars, "cannot combine 'void'");
-        typ->kind = T_VOID;
+        *kind = T_VOID;
         next(pars);
         break;
     case TK_INT:
-        if (typ->kind != T_UNKNOWN)
+        if (*kind != T_UNKNOWN)
             parser_error(pars, "cannot combine 'int'");
-        typ->kind = T_INT;
+        *kind = T_INT;
         next(pars);
         break;
     default:
@@ -987,15 +1163,17 @@ parse_declaration_specifier(PARSER *pars, STORAGE_CLASS* sc, TYPE *typ)
 declaration_specifiers
     = declaration_specifier {declaration_specifier}
 */
-static void
-parse_declaration_specifiers(PARSER *pars, STORAGE_CLASS *sc, TYPE *typ)
+static TYPE *parse_declaration_specifiers(PARSER *pars, STORAGE_CLASS *sc)
 {
+    TYPE_KIND kind = T_UNKNOWN;
+
     ENTER("parse_declaration_specifiers");
-    parse_declaration_specifier(pars, sc, typ);
+    parse_declaration_specifier(pars, sc, &kind);
     while (is_declaration_specifier(pars)) {
-        parse_declaration_specifier(pars, sc, typ);
+        parse_declaration_specifier(pars, sc, &kind);
     }
     LEAVE("parse_declaration_specifiers");
+    return new_type(pars->cc, kind, NULL, NULL);
 }
 
 /*
@@ -1011,9 +1189,8 @@ static void parse_declaration(PARSER *pars, int *var_num)
 
     ENTER("parse_declaration");
 
-    typ = new_type(T_UNKNOWN, NULL, NULL);
     sc = SC_DEFAULT;
-    parse_declaration_specifiers(pars, &sc, typ);
+    typ = parse_declaration_specifiers(pars, &sc);
 
     for (;;) {
         char *id;
@@ -1021,11 +1198,11 @@ static void parse_declaration(PARSER *pars, int *var_num)
         SYMBOL_KIND symkind;
         bool already = false;
 
-        ntyp = dup_type(typ);
+        ntyp = typ;
         parse_declarator(pars, &ntyp, &id);
 
 
-        if (is_debug("parser")) {
+        if (is_debug(DEBUG_PARSER)) {
             printf("local id:%s %d %s type:",
                     id, *var_num, get_storage_class_string(sc));
             print_type(ntyp);
@@ -1034,7 +1211,7 @@ static void parse_declaration(PARSER *pars, int *var_num)
 
         symkind = (ntyp->kind == T_FUNC) ? SK_FUNC : SK_VAR;
         if (symkind == SK_FUNC) {
-            SYMBOL *same = lookup_symbol(id);
+            SYMBOL *same = lookup_symbol(pars->cc, id);
             if (same) {
                 if (same->kind != SK_FUNC) {
                     parser_error(pars, "'%s' differenct kind of symbol", id);
@@ -1044,14 +1221,14 @@ static void parse_declaration(PARSER *pars, int *var_num)
                     already = true;
             }
         } else {
-            SYMBOL *same = lookup_symbol_local(id);
+            SYMBOL *same = lookup_symbol_local(pars->cc, id);
             if (same) {
                 parser_error(pars, "'%s' duplicated", id);
             }
         }
         if (!already) {
             int num = *var_num == 0 ? 0 : (*var_num)++;
-            new_symbol(symkind, sc, id, ntyp, num);
+            new_symbol(pars->cc, symkind, sc, id, ntyp, num);
         }
 
         if (pars->token != TK_COMMA)
@@ -1062,6 +1239,281 @@ static void parse_declaration(PARSER *pars, int *var_num)
     LEAVE("parse_declaration");
 }
 
+/* the body of sym, at its '{' */
+static void parse_function_body(PARSER *pars, SYMBOL *sym, PARAM *param_list)
+{
+    NODE *body;
+    PARAM *p;
+    int var_num;
+
+    sym->tab = enter_function(pars->cc, sym);
+    var_num = -1;
+    for (p = param_list; p != NULL; p = p->next) {
+        new_symbol(pars->cc, SK_VAR, SC_DEFAULT, p->id, p->type,
+                   var_num--);
+        if (is_debug(DEBUG_PARSER)) {
+            printf("param id:%s type:", p->id);
+            print_type(p->type);
+            printf("\n");
+        }
+    }
+    body = parse_compound_statement(pars, 1);
+    /*TODO calc local table size */
+    sym->has_body = true;
+    sym->body_node = body;
+    leave_function(pars->cc);
+}
+
+/*
+ * lazy bodies
+ * the body of a function is skipped by matching its braces, and the
+ * place of its '{' kept, with the names of the parameters and the
+ * globals declared before it: a body parsed later sees only those.
+ */
+struct skipped_body {
+    SYMBOL *sym;
+    PARAM *param;
+    size_t token;           /* of the '{', 0 once parsed */
+    SYMTAB *globals;        /* the global scope as it was */
+    char *diag;             /* of a body parsed on a thread */
+    size_t diag_len;
+    int errors;
+    ERROR_MARK *error_mark; /* where its errors end in diag */
+};
+
+/* the whole input is lexed first, as a body is parsed from its tokens */
+void skip_bodies(PARSER *pars)
+{
+    if (!pars->prelexed)
+        prelex(pars);
+    pars->lazy = true;
+}
+
+static void skip_body(PARSER *pars, SYMBOL *sym, PARAM *param_list)
+{
+    const unsigned char *kind = pars->tokens->kind;
+    size_t i, end = pars->tokens->count - 1;    /* at TK_EOF */
+    struct skipped_body *b;
+    int depth = 1;
+
+    if (pars->n_skipped == pars->skipped_size) {
+        size_t size = pars->skipped_size ? pars->skipped_size * 2 : 64;
+        b = (struct skipped_body*) alloc(size * sizeof (*b));
+        memcpy(b, pars->skipped, pars->n_skipped * sizeof (*b));
+        free(pars->skipped);
+        pars->skipped = b;
+        pars->skipped_size = size;
+    }
+    b = &pars->skipped[pars->n_skipped++];
+    b->sym = sym;
+    b->param = param_list;
+    b->token = pars->next - 1;
+    b->globals = new_symtab(pars->cc, NULL);
+    b->globals->sym = get_scope(pars->cc)->sym;
+    b->diag = NULL;
+    b->diag_len = 0;
+    b->errors = 0;
+    b->error_mark = NULL;
+    sym->has_body = true;
+    sym->body_index = pars->n_skipped;
+
+    for (i = pars->next; i < end; i++) {
+        if (kind[i] == TK_BEGIN)
+            depth++;
+        else if (kind[i] == TK_END && --depth == 0)
+            break;
+    }
+    pars->next = i;
+    next(pars);
+    expect(pars, TK_END);
+}
+
+static bool parse_skipped(PARSER *pars, struct skipped_body *b)
+{
+    jmp_buf recover, *outer = pars->recover;
+    size_t next_token = pars->next;
+    TOKEN token = pars->token;
+    SRCLOC loc = pars->loc;
+    bool ok = true;
+
+    pars->recover = &recover;
+    if (setjmp(recover) == 0) {
+        set_scope(pars->cc, b->globals);
+        pars->next = b->token;
+        next(pars);
+        parse_function_body(pars, b->sym, b->param);
+    } else {
+        b->sym->has_body = false;
+        ok = false;
+    }
+    set_scope(pars->cc, pars->cc->global_table);
+    pars->recover = outer;
+    pars->next = next_token;
+    pars->token = token;
+    pars->loc = loc;
+    b->token = 0;
+    return ok;
+}
+
+/* the body of sym, if it was skipped and not parsed yet */
+bool parse_body(PARSER *pars, SYMBOL *sym)
+{
+    struct skipped_body *b;
+
+    if (sym->body_index == 0)
+        return true;
+    b = &pars->skipped[sym->body_index - 1];
+    return b->token == 0 || parse_skipped(pars, b);
+}
+
+/*
+ * bodies on threads
+ * each thread takes the next body not parsed, with a worker compiler
+ * and a copy of the parser, reading the token stream and the globals
+ * only.  the diagnostics of each body are held, and written in the
+ * order of the source once all are parsed, so the output is the same
+ * as from one thread.  the error limit of the file is applied as they
+ * are written, where each error ends being noted by the worker.
+ */
+#define MAX_BODY_THREADS    64
+
+static int s_body_threads = 1;
+
+void set_body_threads(int n)
+{
+    s_body_threads = n < 1 ? 1 : n < MAX_BODY_THREADS ? n : MAX_BODY_THREADS;
+}
+
+typedef struct {
+    PARSER *pars;
+    size_t next;            /* the next body to hand out */
+    pthread_mutex_t lock;
+} BODY_POOL;
+
+static struct skipped_body *next_body(BODY_POOL *pool)
+{
+    PARSER *pars = pool->pars;
+    struct skipped_body *b = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->next < pars->n_skipped && b == NULL) {
+        b = &pars->skipped[pool->next++];
+        if (b->token == 0)
+            b = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return b;
+}
+
+static void *body_thread(void *arg)
+{
+    BODY_POOL *pool = (BODY_POOL*) arg;
+    COMPILER *w = new_worker(pool->pars->cc);
+    PARSER pars = *pool->pars;
+    struct skipped_body *b;
+    FILE *fp;
+
+    pars.cc = w;
+    pars.recover = NULL;
+    while ((b = next_body(pool)) != NULL) {
+        fp = open_memstream(&b->diag, &b->diag_len);
+        w->diag_fp = fp != NULL ? fp : stdout;
+        w->error_count = 0;
+        if (fp != NULL && w->error_limit > 0) {
+            b->error_mark = (ERROR_MARK*) alloc(w->error_limit
+                                                * sizeof (ERROR_MARK));
+            w->error_mark = b->error_mark;
+        }
+        if (setjmp(w->error_jmp_buf) == 0) {
+            parse_skipped(&pars, b);
+        } else {
+            b->sym->has_body = false;
+            b->token = 0;
+        }
+        flush_diagnostics(w);
+        w->diag_fp = stdout;
+        w->error_mark = NULL;
+        if (fp != NULL)
+            fclose(fp);
+        b->errors = w->error_count;
+    }
+    free_compiler(w);
+    return NULL;
+}
+
+static void parse_bodies_on_threads(PARSER *pars, int n)
+{
+    pthread_t thread[MAX_BODY_THREADS];
+    bool started[MAX_BODY_THREADS] = { false };
+    COMPILER *cc = pars->cc;
+    BODY_POOL pool;
+    size_t i;
+    int n_started = 0;
+    bool limited = false;
+    SRCLOC limit_loc = 0;
+
+    index_sources(cc);
+    pool.pars = pars;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    for (i = 0; i < (size_t) n; i++) {
+        started[i] = pthread_create(&thread[i], NULL, body_thread,
+                                    &pool) == 0;
+        n_started += started[i];
+    }
+    if (n_started == 0)
+        body_thread(&pool);     /* no threads: all of it here */
+    for (i = 0; i < (size_t) n; i++) {
+        if (started[i])
+            pthread_join(thread[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    /* up to the error that reaches the limit, as with one thread */
+    flush_diagnostics(cc);
+    for (i = 0; i < pars->n_skipped; i++) {
+        struct skipped_body *b = &pars->skipped[i];
+        size_t len = b->diag_len;
+        move_arena(b->sym->arena, cc);
+        if (!limited && b->error_mark != NULL
+                && cc->error_count + b->errors >= cc->error_limit) {
+            int k = cc->error_limit - cc->error_count - 1;
+            len = b->error_mark[k].end;
+            limit_loc = b->error_mark[k].loc;
+            cc->error_count = cc->error_limit;
+            limited = true;
+        } else if (!limited)
+            cc->error_count += b->errors;
+        else
+            len = 0;
+        if (b->diag != NULL)
+            fwrite(b->diag, 1, len, cc->diag_fp);
+        free(b->diag);
+        free(b->error_mark);
+        b->diag = NULL;
+        b->error_mark = NULL;
+        b->errors = 0;
+    }
+    if (limited)
+        give_up(cc, limit_loc);
+}
+
+/* the bodies not parsed yet, in the order of the source */
+bool parse_bodies(PARSER *pars)
+{
+    size_t i;
+
+    if (s_body_threads > 1 && pars->n_skipped > 1) {
+        parse_bodies_on_threads(pars, s_body_threads);
+    } else {
+        for (i = 0; i < pars->n_skipped; i++) {
+            if (pars->skipped[i].token != 0)
+                parse_skipped(pars, &pars->skipped[i]);
+        }
+    }
+    return get_error_count(pars->cc) == 0;
+}
+
 /*
 external_declaration
     = declaration_specifiers declarator ';'
@@ -1078,16 +1530,15 @@ static bool parse_external_delaration(PARSER *pars)
 
     ENTER("parse_external_delaration");
 
-    typ = new_type(T_UNKNOWN, NULL, NULL);
     sc = SC_DEFAULT;
-    parse_declaration_specifiers(pars, &sc, typ);
+    typ = parse_declaration_specifiers(pars, &sc);
 
     param_list = parse_declarator(pars, &typ, &id);
 
     symkind = (typ->kind == T_FUNC) ? SK_FUNC : SK_VAR;
 
     /* check same symbol */
-    sym = lookup_symbol(id);
+    sym = lookup_symbol(pars->cc, id);
     if (sym) {
         if (sym->kind == SK_FUNC && symkind == SK_FUNC) {
             if (!equal_type(sym->type, typ)) {
@@ -1102,34 +1553,20 @@ static bool parse_external_delaration(PARSER *pars)
 
     if (pars->token == TK_SEMI) {
         if (sym == NULL)
-            sym = new_symbol(symkind, sc, id, typ, 0);
+            sym = new_symbol(pars->cc, symkind, sc, id, typ, 0);
         next(pars);
     } else if (pars->token == TK_BEGIN) {
-        NODE *body;
-        PARAM *p;
-        int var_num;
         if (symkind != SK_FUNC)
             parser_error(pars, "invalid function syntax");
         if (sym) {
             if (sym->has_body)
                 parser_error(pars, "'%s' redefinition", id);
         } else
-            sym = new_symbol(SK_FUNC, sc, id, typ, 0);
-        sym->tab = enter_function(sym);
-        var_num = -1;
-        for (p = param_list; p != NULL; p = p->next) {
-            new_symbol(SK_VAR, SC_DEFAULT, p->id, p->type, var_num--);
-            if (is_debug("parser")) {
-                printf("param id:%s type:", p->id);
-                print_type(p->type);
-                printf("\n");
-            }
-        }
-        body = parse_compound_statement(pars, 1);
-        /*TODO calc local table size */
-        sym->has_body = true;
-        sym->body_node = body;
-        leave_function();
+            sym = new_symbol(pars->cc, SK_FUNC, sc, id, typ, 0);
+        if (pars->lazy)
+            skip_body(pars, sym, param_list);
+        else
+            parse_function_body(pars, sym, param_list);
     } else {
         parser_error(pars, "syntax error");
     }
@@ -1140,14 +1577,30 @@ static bool parse_external_delaration(PARSER *pars)
 /*
 translation_unit
     = {external_declaration}
+false when there were errors; a declaration with an error is skipped,
+and the next one parsed.
 */
 bool parse(PARSER *pars)
 {
+    jmp_buf recover;
+    SYMTAB *scope = get_scope(pars->cc);
+
+    clear_error_count(pars->cc);
+    pars->recover = &recover;
     next(pars);
     while (pars->token != TK_EOF) {
-         if (!parse_external_delaration(pars))
-            return false;
+        if (pars->pch != NULL)
+            save_prefix(pars);
+        if (setjmp(recover) == 0) {
+            parse_external_delaration(pars);
+        } else {
+            set_scope(pars->cc, scope);
+            skip_declaration(pars, true);
+        }
     }
-    return true;
+    pars->recover = NULL;
+    if (pars->pch != NULL)
+        save_prefix(pars);
+    return get_error_count(pars->cc) == 0;
 }
 
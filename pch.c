@@ -0,0 +1,303 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mcc.h"
+
+/*
+ * precompiled prefix
+ * the declarations read from the headers at the top of a file are kept
+ * in an image: the macros and include guards of the preprocessor, the
+ * types and the global symbols.  a later compile of a file with the
+ * same prefix maps the image and goes on from the first token after it.
+ *
+ * the image is a header followed by sections of fixed size records,
+ * whose layout belongs to the module writing them.  strings are stored
+ * once, and referred to by number.
+ */
+
+#define PCH_MAGIC       "MCC-PCH"
+#define PCH_VERSION     2
+#define PCH_ALIGN       8
+
+typedef struct {
+    char magic[8];
+    unsigned version;
+    unsigned n_sections;
+    struct {
+        unsigned offset;
+        unsigned size;
+    } section[PCH_N_SECTIONS];
+} PCH_HEADER;
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} PCH_BUFFER;
+
+struct pch {
+    COMPILER *cc;
+    const char *path;
+    /* writing */
+    PCH_BUFFER section[PCH_N_SECTIONS];
+    unsigned *string_index;     /* by identifier number, 0: not stored */
+    size_t n_string_index;
+    /* reading */
+    void *map;
+    size_t map_size;
+    char **id;                  /* interned strings, made on demand */
+};
+
+PCH *new_pch(const char *path)
+{
+    PCH *pch = (PCH*) alloc(sizeof (PCH));
+    memset(pch, 0, sizeof (PCH));
+    pch->path = path;
+    return pch;
+}
+
+void free_pch(PCH *pch)
+{
+    int i;
+
+    if (pch == NULL)
+        return;
+    for (i = 0; i < PCH_N_SECTIONS; i++)
+        free(pch->section[i].data);
+    free(pch->string_index);
+    if (pch->map != NULL)
+        munmap(pch->map, pch->map_size);
+    free(pch->id);
+    free(pch);
+}
+
+void pch_put(PCH *pch, PCH_SECTION sec, const void *rec, size_t size)
+{
+    PCH_BUFFER *b = &pch->section[sec];
+
+    if (b->size + size > b->capacity) {
+        char *p;
+        b->capacity = b->capacity ? b->capacity * 2 : 4096;
+        while (b->size + size > b->capacity)
+            b->capacity *= 2;
+        p = (char*) alloc(b->capacity);
+        memcpy(p, b->data, b->size);
+        free(b->data);
+        b->data = p;
+    }
+    memcpy(b->data + b->size, rec, size);
+    b->size += size;
+}
+
+/* records written so far, which is also the number of the next one */
+unsigned pch_count(const PCH *pch, PCH_SECTION sec, size_t size)
+{
+    return pch->section[sec].size / size;
+}
+
+/* number of an interned string in the image, PCH_NONE for NULL */
+unsigned pch_string(PCH *pch, const char *id)
+{
+    unsigned num;
+
+    if (id == NULL)
+        return PCH_NONE;
+    num = ident_number(id);
+    if (num >= pch->n_string_index) {
+        size_t size = pch->n_string_index ? pch->n_string_index : 1024;
+        unsigned *p;
+        while (size <= num)
+            size *= 2;
+        p = (unsigned*) alloc(size * sizeof (unsigned));
+        memcpy(p, pch->string_index, pch->n_string_index * sizeof (unsigned));
+        memset(p + pch->n_string_index, 0,
+                (size - pch->n_string_index) * sizeof (unsigned));
+        free(pch->string_index);
+        pch->string_index = p;
+        pch->n_string_index = size;
+    }
+    if (pch->string_index[num] == 0) {
+        unsigned offset = pch->section[PCH_TEXT].size;
+        pch_put(pch, PCH_STRINGS, &offset, sizeof offset);
+        pch_put(pch, PCH_TEXT, id, strlen(id) + 1);
+        pch->string_index[num] = pch_count(pch, PCH_STRINGS, sizeof offset);
+    }
+    return pch->string_index[num] - 1;
+}
+
+/*
+ * written to a temporary file first, so a reader never sees half of it.
+ * the name is made unique, as files compiled at once may all write one.
+ */
+bool write_pch(PCH *pch)
+{
+    static const char pad[PCH_ALIGN];
+    PCH_HEADER header;
+    unsigned offset = sizeof header;
+    char *tmp;
+    FILE *fp;
+    int i, fd;
+
+    memset(&header, 0, sizeof header);
+    strcpy(header.magic, PCH_MAGIC);
+    header.version = PCH_VERSION;
+    header.n_sections = PCH_N_SECTIONS;
+    for (i = 0; i < PCH_N_SECTIONS; i++) {
+        offset = (offset + PCH_ALIGN - 1) / PCH_ALIGN * PCH_ALIGN;
+        header.section[i].offset = offset;
+        header.section[i].size = pch->section[i].size;
+        offset += pch->section[i].size;
+    }
+
+    tmp = (char*) alloc(strlen(pch->path) + 8);
+    strcpy(tmp, pch->path);
+    strcat(tmp, ".XXXXXX");
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        return false;
+    }
+    fp = fdopen(fd, "wb");
+    if (fp == NULL) {
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        return false;
+    }
+    offset = sizeof header;
+    fwrite(&header, sizeof header, 1, fp);
+    for (i = 0; i < PCH_N_SECTIONS; i++) {
+        fwrite(pad, header.section[i].offset - offset, 1, fp);
+        fwrite(pch->section[i].data, pch->section[i].size, 1, fp);
+        offset = header.section[i].offset + pch->section[i].size;
+    }
+    if (fclose(fp) != 0 || rename(tmp, pch->path) != 0) {
+        unlink(tmp);
+        free(tmp);
+        return false;
+    }
+    free(tmp);
+    return true;
+}
+
+/* NULL when there is no image, or not one this version can read */
+PCH *read_pch(COMPILER *cc, const char *path)
+{
+    const PCH_HEADER *header;
+    struct stat st;
+    PCH *pch;
+    void *map;
+    int fd, i;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof (PCH_HEADER)) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    pch = new_pch(path);
+    pch->cc = cc;
+    pch->map = map;
+    pch->map_size = st.st_size;
+    header = (const PCH_HEADER*) map;
+    if (memcmp(header->magic, PCH_MAGIC, sizeof header->magic) != 0
+            || header->version != PCH_VERSION
+            || header->n_sections != PCH_N_SECTIONS) {
+        free_pch(pch);
+        return NULL;
+    }
+    for (i = 0; i < PCH_N_SECTIONS; i++) {
+        if (header->section[i].offset % PCH_ALIGN != 0
+                || header->section[i].offset > pch->map_size
+                || header->section[i].size
+                    > pch->map_size - header->section[i].offset) {
+            free_pch(pch);
+            return NULL;
+        }
+    }
+    i = header->section[PCH_STRINGS].size / sizeof (unsigned);
+    pch->id = (char**) alloc((i + 1) * sizeof (char*));
+    memset(pch->id, 0, (i + 1) * sizeof (char*));
+    return pch;
+}
+
+const void *pch_section(const PCH *pch, PCH_SECTION sec, size_t size,
+                        unsigned *count)
+{
+    const PCH_HEADER *header = (const PCH_HEADER*) pch->map;
+    *count = header->section[sec].size / size;
+    return (const char*) pch->map + header->section[sec].offset;
+}
+
+/* the string numbered n, interned; NULL for PCH_NONE */
+char *pch_id(PCH *pch, unsigned n)
+{
+    const unsigned *offset;
+    const char *text;
+    unsigned count, size;
+
+    if (n == PCH_NONE)
+        return NULL;
+    offset = (const unsigned*) pch_section(pch, PCH_STRINGS,
+                                           sizeof (unsigned), &count);
+    text = (const char*) pch_section(pch, PCH_TEXT, 1, &size);
+    if (n >= count || offset[n] >= size)
+        return NULL;
+    if (pch->id[n] == NULL)
+        pch->id[n] = intern_n(pch->cc, text + offset[n],
+                              strnlen(text + offset[n], size - offset[n]));
+    return pch->id[n];
+}
+
+/*
+ * -fpch=FILE: the image is used when it was made from the same prefix;
+ * if not, a new one is made from this compile.
+ */
+void use_pch(PARSER *pars, const char *path)
+{
+    PREPROC *pp = get_preproc(pars->scan);
+    PCH *pch = read_pch(pars->cc, path);
+
+    if (pch != NULL && check_preproc(pp, pch)) {
+        load_symtab(pars->cc, pch);
+        load_preproc(pp, pch);
+        free_pch(pch);
+        return;
+    }
+    free_pch(pch);
+    pars->pch = new_pch(path);
+    save_preproc(pp, pars->pch);
+}
+
+/*
+ * called before each external declaration.  the prefix has been parsed
+ * when the declaration begins in the file itself.
+ */
+void save_prefix(PARSER *pars)
+{
+    PCH *pch = pars->pch;
+    const TOKEN_STREAM *ts = pars->tokens;
+
+    if (pars->token != TK_EOF
+            && token_filename(pars->cc, ts, pars->next - 1) != ts->filename)
+        return;
+    pars->pch = NULL;
+    if (pch_count(pch, PCH_KEY, 1) == 0)
+        ;   /* empty prefix */
+    else if (get_error_count(pars->cc) > 0)
+        ;   /* not one to keep */
+    else if (!save_symtab(pars->cc, pch))
+        warning(pars->cc, pars->loc,
+                "'%s' not written: the prefix defines functions", pch->path);
+    else if (!write_pch(pch))
+        warning(pars->cc, pars->loc, "can't write '%s'", pch->path);
+    free_pch(pch);
+}
@@ -0,0 +1,1520 @@
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "mcc.h"
+
+/*
+ * preprocessor
+ * sits between scan_token() and next_token().  directives are carried
+ * out as they are met and macros are expanded on tokens, so nothing is
+ * turned back into text on the way to the parser.
+ *
+ * macro expansion keeps a stack of contexts, one per macro being
+ * expanded; a macro is not expanded again while its context is on the
+ * stack, and an identifier found so is never expanded afterwards.
+ */
+
+#define MAX_INCLUDE_DEPTH   200
+#define MAX_PATH_LEN        1024
+
+#define PP_NOEXPAND     1       /* identifier that must not be expanded */
+
+typedef struct {
+    TOKEN kind;
+    int flags;
+    char *id;
+    int num;
+    SRCLOC loc;
+} PP_TOKEN;
+
+typedef struct {
+    PP_TOKEN *tok;
+    int count;
+    int size;
+} PP_LIST;
+
+typedef struct {
+    char *name;
+    int n_params;           /* -1: object-like */
+    char **params;
+    bool variadic;          /* the last parameter is __VA_ARGS__ */
+    PP_LIST body;
+    bool busy;              /* being expanded */
+} MACRO;
+
+typedef struct context {
+    struct context *next;
+    PP_LIST list;
+    int index;
+    MACRO *macro;           /* enabled again when the context is left */
+    bool barrier;           /* end of a macro argument: do not read on */
+} CONTEXT;
+
+/* what is known of a file after it was read once */
+typedef struct file_info {
+    struct file_info *next;
+    char *path;
+    char *guard;            /* macro of its include guard */
+    bool once;              /* #pragma once */
+} FILE_INFO;
+
+typedef enum {
+    GUARD_START,            /* nothing seen yet */
+    GUARD_IN,               /* in the #ifndef at the top of the file */
+    GUARD_END,              /* after its #endif */
+    GUARD_NONE
+} GUARD_STATE;
+
+typedef struct pp_file {
+    struct pp_file *next;   /* the includer */
+    SCANNER *scan;
+    FILE_INFO *info;
+    int cond_base;          /* conditionals open when the file began */
+    GUARD_STATE guard_state;
+    char *guard;
+} PP_FILE;
+
+typedef struct {
+    SRCLOC loc;
+    bool taken;             /* one of the groups was taken */
+    bool in_else;
+} COND;
+
+struct preproc {
+    COMPILER *cc;
+    PP_FILE *file;
+    int depth;
+    CONTEXT *context;
+    PP_TOKEN ahead;         /* read to look for '(' after a macro name */
+    bool has_ahead;
+    MACRO **macros;         /* indexed by identifier number */
+    size_t n_macros;
+    COND *cond;
+    int n_cond;
+    int cond_size;
+    FILE_INFO *files;
+    char *id_defined;
+    char *id_line;
+    char *id_va_args;
+    bool in_prefix;         /* no token read from the main file yet */
+    PCH *pch;               /* to save the state at the end of the prefix */
+    PP_LIST if_line;        /* of #if, kept here as error() may not return */
+    PP_LIST if_expanded;
+};
+
+static const char **s_include_dirs = NULL;
+static int s_n_include_dirs = 0;
+static const char **s_predefines = NULL;
+static int s_n_predefines = 0;
+
+static const char *const s_system_dirs[] = {
+    "/usr/local/include", "/usr/include"
+};
+
+static void expand_token(PREPROC *pp, PP_TOKEN *t);
+
+static void append_string(const char ***list, int *n, const char *s)
+{
+    const char **p = (const char**) alloc((*n + 1) * sizeof (char*));
+    memcpy(p, *list, *n * sizeof (char*));
+    free(*list);
+    p[(*n)++] = s;
+    *list = p;
+}
+
+void add_include_dir(const char *dir)
+{
+    append_string(&s_include_dirs, &s_n_include_dirs, dir);
+}
+
+/* name or name=value, as given to -D */
+void add_predefine(const char *def)
+{
+    append_string(&s_predefines, &s_n_predefines, def);
+}
+
+/*
+ * token lists
+ */
+static void append_token(PP_LIST *l, const PP_TOKEN *t)
+{
+    if (l->count == l->size) {
+        PP_TOKEN *p;
+        l->size = l->size ? l->size * 2 : 8;
+        p = (PP_TOKEN*) alloc(l->size * sizeof (PP_TOKEN));
+        memcpy(p, l->tok, l->count * sizeof (PP_TOKEN));
+        free(l->tok);
+        l->tok = p;
+    }
+    l->tok[l->count++] = *t;
+}
+
+static void append_list(PP_LIST *l, const PP_LIST *from)
+{
+    int i;
+    for (i = 0; i < from->count; i++)
+        append_token(l, &from->tok[i]);
+}
+
+static void init_list(PP_LIST *l)
+{
+    l->tok = NULL;
+    l->count = 0;
+    l->size = 0;
+}
+
+static void free_list(PP_LIST *l)
+{
+    free(l->tok);
+    init_list(l);
+}
+
+static const char *token_spelling(const PP_TOKEN *t, char *buf)
+{
+    switch (t->kind) {
+    case TK_ID:
+        return t->id;
+    case TK_INT_LIT:
+        sprintf(buf, "%u", (unsigned) t->num);
+        return buf;
+    default:
+        return token_to_string(t->kind);
+    }
+}
+
+/*
+ * macro table
+ */
+static MACRO *lookup_macro(const PREPROC *pp, const char *id)
+{
+    unsigned n = ident_number(id);
+    return n < pp->n_macros ? pp->macros[n] : NULL;
+}
+
+static void free_macro(MACRO *m)
+{
+    if (m == NULL)
+        return;
+    free(m->params);
+    free_list(&m->body);
+    free(m);
+}
+
+static void set_macro(PREPROC *pp, const char *id, MACRO *m)
+{
+    unsigned n = ident_number(id);
+    if (n >= pp->n_macros) {
+        size_t size = pp->n_macros ? pp->n_macros : 256;
+        MACRO **p;
+        while (size <= n)
+            size *= 2;
+        p = (MACRO**) alloc(size * sizeof (MACRO*));
+        memcpy(p, pp->macros, pp->n_macros * sizeof (MACRO*));
+        memset(p + pp->n_macros, 0, (size - pp->n_macros) * sizeof (MACRO*));
+        free(pp->macros);
+        pp->macros = p;
+        pp->n_macros = size;
+    }
+    free_macro(pp->macros[n]);
+    pp->macros[n] = m;
+}
+
+static int param_index(const MACRO *m, const PP_TOKEN *t)
+{
+    int i;
+    if (t->kind != TK_ID)
+        return -1;
+    for (i = 0; i < m->n_params; i++)
+        if (m->params[i] == t->id)
+            return i;
+    return -1;
+}
+
+static bool same_macro(const MACRO *a, const MACRO *b)
+{
+    int i;
+    if (a->n_params != b->n_params || a->variadic != b->variadic
+            || a->body.count != b->body.count)
+        return false;
+    for (i = 0; i < a->n_params; i++)
+        if (a->params[i] != b->params[i])
+            return false;
+    for (i = 0; i < a->body.count; i++) {
+        const PP_TOKEN *p = &a->body.tok[i], *q = &b->body.tok[i];
+        if (p->kind != q->kind || p->id != q->id || p->num != q->num)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * files
+ */
+static FILE_INFO *find_file_info(PREPROC *pp, char *path)
+{
+    FILE_INFO *info;
+    for (info = pp->files; info != NULL; info = info->next)
+        if (info->path == path)
+            return info;
+    info = (FILE_INFO*) alloc(sizeof (FILE_INFO));
+    info->path = path;
+    info->guard = NULL;
+    info->once = false;
+    info->next = pp->files;
+    pp->files = info;
+    return info;
+}
+
+static void push_file(PREPROC *pp, SCANNER *scan, FILE_INFO *info)
+{
+    PP_FILE *f = (PP_FILE*) alloc(sizeof (PP_FILE));
+    f->next = pp->file;
+    f->scan = scan;
+    f->info = info;
+    f->cond_base = pp->n_cond;
+    f->guard_state = GUARD_START;
+    f->guard = NULL;
+    pp->file = f;
+    pp->depth++;
+}
+
+static void pop_file(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    pp->file = f->next;
+    pp->depth--;
+    close_scanner(f->scan);
+    free(f);
+}
+
+static void scan_raw(PP_FILE *f, PP_TOKEN *t)
+{
+    SCANNER *scan = f->scan;
+    t->kind = scan_token(scan);
+    t->flags = 0;
+    t->id = scan->id;
+    t->num = scan->num;
+    t->loc = scan->loc;
+}
+
+/* next token of the directive being read; false at the end of its line */
+static bool directive_token(PP_FILE *f, PP_TOKEN *t)
+{
+    if (scan_eol(f->scan))
+        return false;
+    scan_raw(f, t);
+    return true;
+}
+
+static void end_directive(PREPROC *pp, const char *name)
+{
+    PP_TOKEN t;
+    if (directive_token(pp->file, &t)) {
+        warning(pp->cc, t.loc, "extra tokens at end of #%s directive", name);
+        skip_rest_of_line(pp->file->scan);
+    }
+}
+
+static char *expect_macro_name(PREPROC *pp, const char *name)
+{
+    PP_TOKEN t;
+    if (!directive_token(pp->file, &t))
+        error(pp->cc, scan_loc(pp->file->scan),
+                "no macro name given in #%s directive", name);
+    if (t.kind != TK_ID)
+        error(pp->cc, t.loc, "macro names must be identifiers");
+    return t.id;
+}
+
+/*
+ * contexts
+ */
+static void push_context(PREPROC *pp, PP_LIST *list, MACRO *m, bool barrier)
+{
+    CONTEXT *c = (CONTEXT*) alloc(sizeof (CONTEXT));
+    c->next = pp->context;
+    c->list = *list;
+    c->index = 0;
+    c->macro = m;
+    c->barrier = barrier;
+    if (m != NULL)
+        m->busy = true;
+    pp->context = c;
+}
+
+static void pop_context(PREPROC *pp)
+{
+    CONTEXT *c = pp->context;
+    pp->context = c->next;
+    if (c->macro != NULL)
+        c->macro->busy = false;
+    free_list(&c->list);
+    free(c);
+}
+
+/* leave the contexts that are used up, up to a barrier */
+static CONTEXT *current_context(PREPROC *pp)
+{
+    CONTEXT *c;
+    while ((c = pp->context) != NULL && c->index == c->list.count
+            && !c->barrier)
+        pop_context(pp);
+    return c;
+}
+
+static void directive(PREPROC *pp);
+static void end_prefix(PREPROC *pp);
+
+/* next token from the files, carrying out directives */
+static void read_token(PREPROC *pp, PP_TOKEN *t)
+{
+    for (;;) {
+        PP_FILE *f = pp->file;
+        scan_raw(f, t);
+        if (t->kind == TK_HASH && f->scan->first) {
+            directive(pp);
+            continue;
+        }
+        if (t->kind == TK_EOF) {
+            if (pp->n_cond > f->cond_base)
+                error(pp->cc, pp->cond[pp->n_cond - 1].loc,
+                        "unterminated conditional directive");
+            if (f->guard_state == GUARD_END)
+                f->info->guard = f->guard;
+            if (f->next == NULL) {
+                if (pp->in_prefix)
+                    end_prefix(pp);
+                return;
+            }
+            pop_file(pp);
+            continue;
+        }
+        if (f->guard_state != GUARD_IN)
+            f->guard_state = GUARD_NONE;
+        if (f->next == NULL && pp->in_prefix)
+            end_prefix(pp);
+        return;
+    }
+}
+
+static void get_token(PREPROC *pp, PP_TOKEN *t)
+{
+    CONTEXT *c = current_context(pp);
+
+    if (c != NULL) {
+        if (c->index < c->list.count) {
+            *t = c->list.tok[c->index++];
+            return;
+        }
+        t->kind = TK_EOF;       /* at a barrier */
+        t->flags = 0;
+        t->loc = pp->file->scan->loc;
+        return;
+    }
+    if (pp->has_ahead) {
+        *t = pp->ahead;
+        pp->has_ahead = false;
+        return;
+    }
+    read_token(pp, t);
+}
+
+/* is the next token '(' ?  it is not taken. */
+static bool next_is_lpar(PREPROC *pp)
+{
+    CONTEXT *c = current_context(pp);
+
+    if (c != NULL)
+        return c->index < c->list.count
+                && c->list.tok[c->index].kind == TK_LPAR;
+    if (!pp->has_ahead) {
+        read_token(pp, &pp->ahead);
+        pp->has_ahead = true;
+    }
+    return pp->ahead.kind == TK_LPAR;
+}
+
+/* macro expand a list on its own, as for an argument */
+static void expand_list(PREPROC *pp, const PP_LIST *in, PP_LIST *out)
+{
+    PP_LIST copy;
+    PP_TOKEN t;
+
+    init_list(&copy);
+    append_list(&copy, in);
+    push_context(pp, &copy, NULL, true);
+    for (;;) {
+        expand_token(pp, &t);
+        if (t.kind == TK_EOF && pp->context->barrier
+                && pp->context->index == pp->context->list.count)
+            break;
+        append_token(out, &t);
+    }
+    pop_context(pp);
+}
+
+/* the arguments of a macro call; the '(' is the next token */
+static PP_LIST *read_args(PREPROC *pp, MACRO *m, const PP_TOKEN *name)
+{
+    int n = m->n_params > 0 ? m->n_params : 1;
+    PP_LIST *args = (PP_LIST*) alloc(n * sizeof (PP_LIST));
+    int i, depth = 0;
+    PP_TOKEN t;
+
+    for (i = 0; i < n; i++)
+        init_list(&args[i]);
+    get_token(pp, &t);
+    i = 0;
+    for (;;) {
+        get_token(pp, &t);
+        if (t.kind == TK_EOF)
+            error(pp->cc, name->loc,
+                    "unterminated argument list invoking macro '%s'", m->name);
+        if (depth == 0 && t.kind == TK_RPAR)
+            break;
+        if (depth == 0 && t.kind == TK_COMMA
+                && !(m->variadic && i == m->n_params - 1)) {
+            if (++i >= m->n_params)
+                error(pp->cc, name->loc,
+                        "macro '%s' passed too many arguments", m->name);
+            continue;
+        }
+        if (t.kind == TK_LPAR)
+            depth++;
+        else if (t.kind == TK_RPAR)
+            depth--;
+        append_token(&args[i], &t);
+    }
+    if (m->n_params == 0 && args[0].count > 0)
+        error(pp->cc, name->loc, "macro '%s' passed too many arguments",
+                m->name);
+    if (m->n_params > 0 && i < m->n_params - 1
+            && !(m->variadic && i == m->n_params - 2))
+        error(pp->cc, name->loc,
+                "macro '%s' requires %d arguments, but only %d given",
+                m->name, m->n_params, i + 1);
+    return args;
+}
+
+static void free_args(const MACRO *m, PP_LIST *args)
+{
+    int i;
+    for (i = 0; i < m->n_params || i == 0; i++)
+        free_list(&args[i]);
+    free(args);
+}
+
+/* a ## b: the spellings joined must make one token */
+static void paste(PREPROC *pp, PP_TOKEN *a, const PP_TOKEN *b)
+{
+    char buf1[16], buf2[16];
+    const char *s1 = token_spelling(a, buf1), *s2 = token_spelling(b, buf2);
+    char *text = (char*) alloc(strlen(s1) + strlen(s2) + 1);
+    SCANNER *scan;
+    TOKEN tk;
+
+    strcpy(text, s1);
+    strcat(text, s2);
+    scan = open_scanner_at(pp->cc, a->loc, text, strlen(text));
+    tk = scan_token(scan);
+    if (tk == TK_EOF || scan_token(scan) != TK_EOF)
+        error(pp->cc, a->loc, "pasting \"%s\" and \"%s\" does not give a "
+                "valid token", s1, s2);
+    a->kind = tk;
+    a->flags = 0;
+    a->id = scan->id;
+    a->num = scan->num;
+    close_scanner(scan);
+    free(text);
+}
+
+/* the replacement list of m with the arguments put in */
+static void substitute(PREPROC *pp, const MACRO *m, PP_LIST *args,
+                       PP_LIST *out)
+{
+    const PP_LIST *body = &m->body;
+    int i, p, start = 0;
+
+    for (i = 0; i < body->count; i++) {
+        const PP_TOKEN *t = &body->tok[i];
+        bool pasted = (i + 1 < body->count
+                        && body->tok[i+1].kind == TK_HASHHASH);
+
+        if (t->kind == TK_HASHHASH) {
+            const PP_TOKEN *rhs = &body->tok[++i];
+            int j = 0;
+            p = param_index(m, rhs);
+            if (p < 0) {
+                if (out->count == start)
+                    append_token(out, rhs);
+                else
+                    paste(pp, &out->tok[out->count - 1], rhs);
+            } else if (args[p].count > 0) {
+                if (out->count > start)
+                    paste(pp, &out->tok[out->count - 1], &args[p].tok[j++]);
+                for (; j < args[p].count; j++)
+                    append_token(out, &args[p].tok[j]);
+            }
+            continue;
+        }
+        start = out->count;
+        p = param_index(m, t);
+        if (p < 0)
+            append_token(out, t);
+        else if (pasted)
+            append_list(out, &args[p]);
+        else
+            expand_list(pp, &args[p], out);
+    }
+}
+
+/* next token, macro expanded */
+static void expand_token(PREPROC *pp, PP_TOKEN *t)
+{
+    for (;;) {
+        PP_LIST list, *args = NULL;
+        MACRO *m;
+        PP_TOKEN name;
+        int i;
+
+        get_token(pp, t);
+        if (t->kind != TK_ID || (t->flags & PP_NOEXPAND))
+            return;
+        if (t->id == pp->id_line) {
+            t->kind = TK_INT_LIT;
+            t->num = loc_line(pp->cc, t->loc);
+            return;
+        }
+        m = lookup_macro(pp, t->id);
+        if (m == NULL)
+            return;
+        if (m->busy) {
+            t->flags |= PP_NOEXPAND;
+            return;
+        }
+        if (m->n_params >= 0 && !next_is_lpar(pp))
+            return;
+        name = *t;
+        if (m->n_params >= 0)
+            args = read_args(pp, m, &name);
+        init_list(&list);
+        substitute(pp, m, args, &list);
+        for (i = 0; i < list.count; i++)
+            list.tok[i].loc = name.loc;
+        if (args != NULL)
+            free_args(m, args);
+        push_context(pp, &list, m, false);
+    }
+}
+
+/*
+ * #define
+ */
+static void read_params(PREPROC *pp, MACRO *m)
+{
+    PP_FILE *f = pp->file;
+    PP_TOKEN t;
+    int size = 0;
+
+    m->n_params = 0;
+    directive_token(f, &t);     /* '(' */
+    for (;;) {
+        if (!directive_token(f, &t))
+            error(pp->cc, scan_loc(f->scan),
+                    "missing ')' in macro parameter list");
+        if (m->n_params == 0 && t.kind == TK_RPAR)
+            return;
+        if (t.kind == TK_ELLIPSIS) {
+            t.id = pp->id_va_args;
+            m->variadic = true;
+        } else if (t.kind != TK_ID || t.id == pp->id_va_args) {
+            error(pp->cc, t.loc, "invalid macro parameter");
+        }
+        if (param_index(m, &t) >= 0)
+            error(pp->cc, t.loc, "duplicate macro parameter '%s'", t.id);
+        if (m->n_params == size) {
+            char **p;
+            size = size ? size * 2 : 4;
+            p = (char**) alloc(size * sizeof (char*));
+            memcpy(p, m->params, m->n_params * sizeof (char*));
+            free(m->params);
+            m->params = p;
+        }
+        m->params[m->n_params++] = t.id;
+        if (!directive_token(f, &t))
+            error(pp->cc, scan_loc(f->scan),
+                    "missing ')' in macro parameter list");
+        if (t.kind == TK_RPAR)
+            return;
+        if (t.kind != TK_COMMA || m->variadic)
+            error(pp->cc, t.loc,
+                    "expected ',' or ')' in macro parameter list");
+    }
+}
+
+static void do_define(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    char *id = expect_macro_name(pp, "define");
+    MACRO *m = (MACRO*) alloc(sizeof (MACRO));
+    MACRO *old;
+    PP_TOKEN t;
+    SRCLOC loc = scan_loc(f->scan);
+
+    m->name = id;
+    m->n_params = -1;
+    m->params = NULL;
+    m->variadic = false;
+    m->busy = false;
+    init_list(&m->body);
+    if (f->scan->ch == '(')     /* no space before '(' */
+        read_params(pp, m);
+    while (directive_token(f, &t)) {
+        if (t.kind == TK_HASH && m->n_params >= 0)
+            error(pp->cc, t.loc, "'#' is not supported in macros");
+        if (t.kind == TK_ID && t.id == pp->id_va_args && !m->variadic)
+            error(pp->cc, t.loc,
+                    "__VA_ARGS__ can only appear in a variadic macro");
+        append_token(&m->body, &t);
+    }
+    if (m->body.count > 0
+            && (m->body.tok[0].kind == TK_HASHHASH
+                || m->body.tok[m->body.count - 1].kind == TK_HASHHASH))
+        error(pp->cc, loc,
+                "'##' cannot appear at either end of a macro expansion");
+
+    old = lookup_macro(pp, id);
+    if (old != NULL && !same_macro(old, m))
+        warning(pp->cc, loc, "'%s' redefined", id);
+    set_macro(pp, id, m);
+}
+
+static void do_undef(PREPROC *pp)
+{
+    char *id = expect_macro_name(pp, "undef");
+    end_directive(pp, "undef");
+    set_macro(pp, id, NULL);
+}
+
+/*
+ * #include
+ */
+static bool find_in_dir(char *path, const char *dir, int len,
+                        const char *name)
+{
+    if (len + strlen(name) + 2 > MAX_PATH_LEN)
+        return false;
+    if (len > 0) {
+        memcpy(path, dir, len);
+        path[len++] = '/';
+    }
+    strcpy(path + len, name);
+    return access(path, R_OK) == 0;
+}
+
+/* "name" is looked for next to the includer first */
+static char *find_include(PREPROC *pp, const char *name, bool system)
+{
+    char path[MAX_PATH_LEN];
+    int i;
+
+    if (name[0] == '/')
+        return access(name, R_OK) == 0 ? intern(pp->cc, name) : NULL;
+    if (!system) {
+        const char *file = loc_filename(pp->cc, pp->file->scan->base);
+        const char *slash = strrchr(file, '/');
+        if (find_in_dir(path, file, slash ? slash - file : 0, name))
+            return intern(pp->cc, path);
+    }
+    for (i = 0; i < s_n_include_dirs; i++)
+        if (find_in_dir(path, s_include_dirs[i], strlen(s_include_dirs[i]),
+                        name))
+            return intern(pp->cc, path);
+    for (i = 0; i < (int) (sizeof s_system_dirs / sizeof s_system_dirs[0]);
+            i++)
+        if (find_in_dir(path, s_system_dirs[i], strlen(s_system_dirs[i]),
+                        name))
+            return intern(pp->cc, path);
+    return NULL;
+}
+
+static void do_include(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    SRCLOC loc = scan_loc(f->scan);
+    bool system;
+    char *name = scan_header_name(f->scan, &system);
+    char *path;
+    FILE_INFO *info;
+    SCANNER *scan;
+
+    if (name == NULL)
+        error(pp->cc, loc, "#include expects \"FILENAME\" or <FILENAME>");
+    end_directive(pp, "include");
+    path = find_include(pp, name, system);
+    if (path == NULL)
+        error(pp->cc, loc, "%s: no such file", name);
+
+    /* known not to add anything: do not even open it */
+    info = find_file_info(pp, path);
+    if (info->once)
+        return;
+    if (info->guard != NULL && lookup_macro(pp, info->guard) != NULL)
+        return;
+
+    if (pp->depth >= MAX_INCLUDE_DEPTH)
+        error(pp->cc, loc, "#include nested too deeply");
+    scan = open_scanner(pp->cc, path);
+    if (scan == NULL)
+        error(pp->cc, loc, "can't open '%s'", path);
+    push_file(pp, scan, info);
+}
+
+/*
+ * #if expressions
+ */
+typedef struct {
+    PP_LIST *list;
+    int i;
+    int dead;               /* inside an operand that is not evaluated */
+    SRCLOC loc;
+    COMPILER *cc;
+} EVAL;
+
+static TOKEN eval_peek(const EVAL *e)
+{
+    return e->i < e->list->count ? e->list->tok[e->i].kind : TK_EOF;
+}
+
+static long eval_cond(EVAL *e);
+
+static long eval_unary(EVAL *e)
+{
+    PP_TOKEN *t;
+    long v;
+
+    if (e->i == e->list->count)
+        error(e->cc, e->loc, "#if with no expression");
+    t = &e->list->tok[e->i++];
+    switch (t->kind) {
+    case TK_INT_LIT:
+        return (unsigned) t->num;
+    case TK_ID:
+        return 0;
+    case TK_PLUS:
+        return eval_unary(e);
+    case TK_MINUS:
+        return (long) -(unsigned long) eval_unary(e);
+    case TK_TILDE:
+        return ~eval_unary(e);
+    case TK_NOT:
+        return !eval_unary(e);
+    case TK_LPAR:
+        v = eval_cond(e);
+        if (eval_peek(e) != TK_RPAR)
+            error(e->cc, e->loc, "missing ')' in expression");
+        e->i++;
+        return v;
+    default:
+        error(e->cc, t->loc, "token \"%s\" is not valid in preprocessor "
+                "expressions", token_to_string(t->kind));
+        return 0;
+    }
+}
+
+static int binary_prec(TOKEN tk)
+{
+    switch (tk) {
+    case TK_STAR: case TK_SLASH: case TK_PERCENT:       return 10;
+    case TK_PLUS: case TK_MINUS:                        return 9;
+    case TK_SHL: case TK_SHR:                           return 8;
+    case TK_LT: case TK_GT: case TK_LE: case TK_GE:     return 7;
+    case TK_EQ: case TK_NEQ:                            return 6;
+    case TK_AND:                                        return 5;
+    case TK_XOR:                                        return 4;
+    case TK_OR:                                         return 3;
+    case TK_LAND:                                       return 2;
+    case TK_LOR:                                        return 1;
+    default:                                            return 0;
+    }
+}
+
+/*
+ * v shifted by n, to the other side when n is negative.  as in gcc, a
+ * shift by the width of long or more leaves 0, or -1 for a negative v
+ * shifted right.
+ */
+static long eval_shift(long v, long n, bool left)
+{
+    unsigned long count = (n < 0) ? -(unsigned long) n : (unsigned long) n;
+    unsigned long bits = sizeof (long) * CHAR_BIT;
+
+    if (n < 0)
+        left = !left;
+    if (left)
+        return (count >= bits) ? 0 : (long) ((unsigned long) v << count);
+    if (count >= bits)
+        return (v < 0) ? -1 : 0;
+    return v >> count;
+}
+
+/* the arithmetic is done in unsigned long, so overflow wraps */
+static long eval_binary(EVAL *e, int min_prec)
+{
+    long v = eval_unary(e);
+
+    for (;;) {
+        TOKEN op = eval_peek(e);
+        int prec = binary_prec(op);
+        bool skip;
+        long r;
+
+        if (prec == 0 || prec < min_prec)
+            return v;
+        e->i++;
+        skip = (op == TK_LAND && !v) || (op == TK_LOR && v);
+        e->dead += skip;
+        r = eval_binary(e, prec + 1);
+        e->dead -= skip;
+        switch (op) {
+        case TK_STAR:
+            v = (long) ((unsigned long) v * (unsigned long) r);
+            break;
+        case TK_SLASH:
+        case TK_PERCENT:
+            if (r == 0) {
+                if (!e->dead)
+                    error(e->cc, e->loc, "division by zero in #if");
+                v = 0;
+            } else if (r == -1) {       /* LONG_MIN / -1 overflows */
+                v = (op == TK_SLASH) ? (long) -(unsigned long) v : 0;
+            } else {
+                v = (op == TK_SLASH) ? v / r : v % r;
+            }
+            break;
+        case TK_PLUS:
+            v = (long) ((unsigned long) v + (unsigned long) r);
+            break;
+        case TK_MINUS:
+            v = (long) ((unsigned long) v - (unsigned long) r);
+            break;
+        case TK_SHL:    v = eval_shift(v, r, true); break;
+        case TK_SHR:    v = eval_shift(v, r, false); break;
+        case TK_LT:     v = v < r; break;
+        case TK_GT:     v = v > r; break;
+        case TK_LE:     v = v <= r; break;
+        case TK_GE:     v = v >= r; break;
+        case TK_EQ:     v = v == r; break;
+        case TK_NEQ:    v = v != r; break;
+        case TK_AND:    v &= r; break;
+        case TK_XOR:    v ^= r; break;
+        case TK_OR:     v |= r; break;
+        case TK_LAND:   v = v && r; break;
+        case TK_LOR:    v = v || r; break;
+        default:        break;
+        }
+    }
+}
+
+static long eval_cond(EVAL *e)
+{
+    long c = eval_binary(e, 1);
+    long a, b;
+
+    if (eval_peek(e) != TK_QUESTION)
+        return c;
+    e->i++;
+    e->dead += !c;
+    a = eval_cond(e);
+    e->dead -= !c;
+    if (eval_peek(e) != TK_COLON)
+        error(e->cc, e->loc, "missing ':' in expression");
+    e->i++;
+    e->dead += !!c;
+    b = eval_cond(e);
+    e->dead -= !!c;
+    return c ? a : b;
+}
+
+/* defined X or defined(X), read before the line is expanded */
+static void read_defined(PREPROC *pp, PP_TOKEN *t)
+{
+    PP_FILE *f = pp->file;
+    SRCLOC loc = t->loc;
+    PP_TOKEN r;
+    bool ok, paren;
+
+    ok = directive_token(f, t);
+    paren = ok && t->kind == TK_LPAR;
+    if (paren)
+        ok = directive_token(f, t);
+    if (!ok || t->kind != TK_ID)
+        error(pp->cc, loc, "operator \"defined\" requires an identifier");
+    if (paren && (!directive_token(f, &r) || r.kind != TK_RPAR))
+        error(pp->cc, loc, "missing ')' after \"defined\"");
+    t->kind = TK_INT_LIT;
+    t->num = lookup_macro(pp, t->id) != NULL;
+}
+
+/* the rest of an #if or #elif line */
+static bool eval_if(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    PP_LIST *line = &pp->if_line;
+    PP_LIST *expanded = &pp->if_expanded;
+    PP_TOKEN t;
+    EVAL e;
+    long v;
+
+    line->count = 0;
+    expanded->count = 0;
+    while (directive_token(f, &t)) {
+        if (t.kind == TK_ID && t.id == pp->id_defined)
+            read_defined(pp, &t);
+        append_token(line, &t);
+    }
+    expand_list(pp, line, expanded);
+    e.list = expanded;
+    e.i = 0;
+    e.dead = 0;
+    e.loc = scan_loc(f->scan);
+    e.cc = pp->cc;
+    v = eval_cond(&e);
+    if (e.i < expanded->count)
+        error(pp->cc, e.loc, "missing binary operator before token \"%s\"",
+                token_to_string(expanded->tok[e.i].kind));
+    return v != 0;
+}
+
+/*
+ * conditionals
+ */
+static void push_cond(PREPROC *pp, SRCLOC loc, bool taken)
+{
+    COND *c;
+    if (pp->n_cond == pp->cond_size) {
+        COND *p;
+        pp->cond_size = pp->cond_size ? pp->cond_size * 2 : 16;
+        p = (COND*) alloc(pp->cond_size * sizeof (COND));
+        memcpy(p, pp->cond, pp->n_cond * sizeof (COND));
+        free(pp->cond);
+        pp->cond = p;
+    }
+    c = &pp->cond[pp->n_cond++];
+    c->loc = loc;
+    c->taken = taken;
+    c->in_else = false;
+}
+
+static COND *top_cond(PREPROC *pp, SRCLOC loc, const char *name)
+{
+    if (pp->n_cond == pp->file->cond_base)
+        error(pp->cc, loc, "#%s without #if", name);
+    return &pp->cond[pp->n_cond - 1];
+}
+
+static void pop_cond(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    pp->n_cond--;
+    if (f->guard_state == GUARD_IN && pp->n_cond == f->cond_base)
+        f->guard_state = GUARD_END;
+}
+
+static void else_cond(PREPROC *pp, COND *c, SRCLOC loc, const char *name)
+{
+    PP_FILE *f = pp->file;
+    if (c->in_else)
+        error(pp->cc, loc, "#%s after #else", name);
+    if (f->guard_state == GUARD_IN && pp->n_cond == f->cond_base + 1)
+        f->guard_state = GUARD_NONE;
+}
+
+/*
+ * skip groups until one is taken, or up to the #endif.
+ * only the directive names are read; the lines are skipped as text.
+ */
+static void skip_groups(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    int depth = 0;
+    PP_TOKEN t;
+
+    for (;;) {
+        COND *c = &pp->cond[pp->n_cond - 1];
+        const char *name;
+
+        skip_group(f->scan);
+        scan_raw(f, &t);
+        if (t.kind == TK_EOF)
+            error(pp->cc, c->loc, "unterminated conditional directive");
+        if (!directive_token(f, &t))
+            continue;
+        name = (t.kind == TK_ID) ? t.id : token_to_string(t.kind);
+        if (strcmp(name, "if") == 0 || strcmp(name, "ifdef") == 0
+                || strcmp(name, "ifndef") == 0) {
+            depth++;
+        } else if (strcmp(name, "endif") == 0) {
+            if (depth-- == 0) {
+                end_directive(pp, name);
+                pop_cond(pp);
+                return;
+            }
+        } else if (depth == 0 && strcmp(name, "elif") == 0) {
+            else_cond(pp, c, t.loc, name);
+            if (!c->taken) {
+                if (eval_if(pp)) {
+                    c->taken = true;
+                    return;
+                }
+                continue;
+            }
+        } else if (depth == 0 && strcmp(name, "else") == 0) {
+            else_cond(pp, c, t.loc, name);
+            c->in_else = true;
+            end_directive(pp, name);
+            if (!c->taken) {
+                c->taken = true;
+                return;
+            }
+            continue;
+        }
+        skip_rest_of_line(f->scan);
+    }
+}
+
+static void do_if(PREPROC *pp, SRCLOC loc, bool taken)
+{
+    push_cond(pp, loc, taken);
+    if (!taken)
+        skip_groups(pp);
+}
+
+static void do_ifdef(PREPROC *pp, SRCLOC loc, const char *name,
+                     bool defined)
+{
+    PP_FILE *f = pp->file;
+    char *id = expect_macro_name(pp, name);
+    end_directive(pp, name);
+    if (f->guard_state == GUARD_START) {
+        f->guard_state = GUARD_IN;
+        f->guard = id;
+    }
+    do_if(pp, loc, (lookup_macro(pp, id) != NULL) == defined);
+}
+
+static void do_pragma(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    PP_TOKEN t;
+    if (directive_token(f, &t) && t.kind == TK_ID
+            && strcmp(t.id, "once") == 0) {
+        end_directive(pp, "pragma once");
+        if (f->info != NULL)
+            f->info->once = true;
+        return;
+    }
+    skip_rest_of_line(f->scan);     /* others are ignored */
+}
+
+/* the '#' beginning the line has been read */
+static void directive(PREPROC *pp)
+{
+    PP_FILE *f = pp->file;
+    PP_TOKEN t;
+    const char *name;
+
+    if (!directive_token(f, &t))
+        return;                 /* null directive */
+    if (t.kind == TK_INT_LIT) {
+        skip_rest_of_line(f->scan);     /* # line "file" from cpp */
+        return;
+    }
+    if (t.kind != TK_ID && t.kind != TK_IF && t.kind != TK_ELSE)
+        error(pp->cc, t.loc, "invalid preprocessing directive");
+    name = (t.kind == TK_ID) ? t.id : token_to_string(t.kind);
+
+    /* only an #ifndef can begin an include guard, and nothing follow it */
+    if (f->guard_state == GUARD_END || (f->guard_state == GUARD_START
+                                        && strcmp(name, "ifndef") != 0))
+        f->guard_state = GUARD_NONE;
+
+    if (strcmp(name, "define") == 0) {
+        do_define(pp);
+    } else if (strcmp(name, "undef") == 0) {
+        do_undef(pp);
+    } else if (strcmp(name, "include") == 0) {
+        do_include(pp);
+    } else if (strcmp(name, "if") == 0) {
+        do_if(pp, t.loc, eval_if(pp));
+    } else if (strcmp(name, "ifdef") == 0) {
+        do_ifdef(pp, t.loc, name, true);
+    } else if (strcmp(name, "ifndef") == 0) {
+        do_ifdef(pp, t.loc, name, false);
+    } else if (strcmp(name, "elif") == 0 || strcmp(name, "else") == 0) {
+        COND *c = top_cond(pp, t.loc, name);
+        else_cond(pp, c, t.loc, name);
+        if (strcmp(name, "else") == 0) {
+            c->in_else = true;
+            end_directive(pp, name);
+        } else {
+            skip_rest_of_line(f->scan);
+        }
+        c->taken = true;        /* a group was taken: skip the rest */
+        skip_groups(pp);
+    } else if (strcmp(name, "endif") == 0) {
+        top_cond(pp, t.loc, name);
+        end_directive(pp, name);
+        pop_cond(pp);
+    } else if (strcmp(name, "pragma") == 0) {
+        do_pragma(pp);
+    } else if (strcmp(name, "error") == 0) {
+        error(pp->cc, t.loc, "#error %s", scan_rest_of_line(f->scan));
+    } else if (strcmp(name, "warning") == 0) {
+        char *text = scan_rest_of_line(f->scan);
+        warning(pp->cc, t.loc, "#warning %s", text);
+        free(text);
+    } else if (strcmp(name, "line") == 0 || strcmp(name, "ident") == 0) {
+        skip_rest_of_line(f->scan);
+    } else {
+        error(pp->cc, t.loc, "invalid preprocessing directive #%s", name);
+    }
+}
+
+/* -D name=value is read as "#define name value" */
+static void predefine(PREPROC *pp, const char *def)
+{
+    char *text = (char*) alloc(strlen(def) + 3);
+    SCANNER *scan;
+    char *p;
+
+    strcpy(text, def);
+    p = strchr(text, '=');
+    if (p != NULL)
+        *p = ' ';
+    else
+        strcat(text, " 1");
+    scan = open_scanner_text(pp->cc, "<command line>", text);
+    scan->bol = false;      /* as if after "#define" */
+    push_file(pp, scan, NULL);
+    do_define(pp);
+    pop_file(pp);
+    free(text);
+}
+
+/*
+ * the preprocessor reads the source through a scanner of its own, so
+ * scan->loc is left to tell the location of the tokens it returns.
+ */
+static PREPROC *new_preproc(SCANNER *scan)
+{
+    PREPROC *pp = (PREPROC*) alloc(sizeof (PREPROC));
+    SCANNER *source = (SCANNER*) alloc(sizeof (SCANNER));
+    int i;
+
+    *source = *scan;
+    scan->buffer = NULL;
+    scan->map = NULL;
+    scan->prescan = NULL;
+    scan->fd = -1;
+
+    pp->cc = scan->cc;
+    pp->file = NULL;
+    pp->depth = 0;
+    pp->context = NULL;
+    pp->has_ahead = false;
+    pp->macros = NULL;
+    pp->n_macros = 0;
+    pp->cond = NULL;
+    pp->n_cond = 0;
+    pp->cond_size = 0;
+    pp->files = NULL;
+    pp->id_defined = intern(pp->cc, "defined");
+    pp->id_line = intern(pp->cc, "__LINE__");
+    pp->id_va_args = intern(pp->cc, "__VA_ARGS__");
+    pp->in_prefix = true;
+    pp->pch = NULL;
+    init_list(&pp->if_line);
+    init_list(&pp->if_expanded);
+    push_file(pp, source, find_file_info(pp, intern(pp->cc,
+                    loc_filename(pp->cc, scan->base))));
+    predefine(pp, "__STDC__");
+    predefine(pp, "__MCC__");
+    for (i = 0; i < s_n_predefines; i++)
+        predefine(pp, s_predefines[i]);
+    return pp;
+}
+
+void free_preproc(PREPROC *pp)
+{
+    size_t i;
+
+    if (pp == NULL)
+        return;
+    while (pp->context != NULL)
+        pop_context(pp);
+    while (pp->file != NULL)
+        pop_file(pp);
+    for (i = 0; i < pp->n_macros; i++)
+        free_macro(pp->macros[i]);
+    free(pp->macros);
+    free(pp->cond);
+    free_list(&pp->if_line);
+    free_list(&pp->if_expanded);
+    while (pp->files != NULL) {
+        FILE_INFO *info = pp->files;
+        pp->files = info->next;
+        free(info);
+    }
+    free(pp);
+}
+
+PREPROC *get_preproc(SCANNER *scan)
+{
+    if (scan->pp == NULL)
+        scan->pp = new_preproc(scan);
+    return scan->pp;
+}
+
+/* the scanner the main file is read through */
+SCANNER *source_scanner(SCANNER *scan)
+{
+    const PP_FILE *f = get_preproc(scan)->file;
+
+    while (f->next != NULL)
+        f = f->next;
+    return f->scan;
+}
+
+TOKEN next_token(SCANNER *scan)
+{
+    PP_TOKEN t;
+
+    expand_token(get_preproc(scan), &t);
+    scan->id = t.id;
+    scan->num = t.num;
+    scan->loc = t.loc;
+    return t.kind;
+}
+
+/*
+ * precompiled prefix
+ * the prefix is the part of the main file before its first token: the
+ * directives, and the headers they include.  it is keyed by a hash of
+ * its text and of the options, and by the size and time of the headers.
+ */
+typedef struct {
+    unsigned size;          /* of the prefix, the offset of the token */
+    unsigned bol;
+    unsigned hash;
+    unsigned options;
+} PCH_KEY_RECORD;
+
+typedef struct {
+    unsigned path;
+    unsigned guard;
+    unsigned once;
+    unsigned pad;
+    long long size;
+    long long mtime;
+} PCH_FILE_RECORD;
+
+typedef struct {
+    unsigned name;
+    int n_params;
+    unsigned variadic;
+    unsigned params;        /* first in PCH_NAMES */
+    unsigned body;          /* first in PCH_TOKENS */
+    unsigned n_body;
+} PCH_MACRO_RECORD;
+
+typedef struct {
+    unsigned kind;
+    unsigned value;         /* string number of an identifier, or number */
+} PCH_TOKEN_RECORD;
+
+static unsigned options_hash(void)
+{
+    unsigned h = 0;
+    int i;
+
+    for (i = 0; i < s_n_include_dirs; i++)
+        h = h * 31 + hash_string(s_include_dirs[i], strlen(s_include_dirs[i]));
+    h = h * 31 + 1;
+    for (i = 0; i < s_n_predefines; i++)
+        h = h * 31 + hash_string(s_predefines[i], strlen(s_predefines[i]));
+    return h;
+}
+
+/* the prefix can be kept when all of its text is at hand */
+static SCANNER *main_scanner(const PREPROC *pp)
+{
+    const PP_FILE *f = pp->file;
+
+    while (f->next != NULL)
+        f = f->next;
+    if (f->scan->fd >= 0 || f->scan->offset != 0)
+        return NULL;
+    return f->scan;
+}
+
+static void save_macro(PCH *pch, const MACRO *m)
+{
+    PCH_MACRO_RECORD r;
+    int i;
+
+    r.name = pch_string(pch, m->name);
+    r.n_params = m->n_params;
+    r.variadic = m->variadic;
+    r.params = pch_count(pch, PCH_NAMES, sizeof (unsigned));
+    r.body = pch_count(pch, PCH_TOKENS, sizeof (PCH_TOKEN_RECORD));
+    r.n_body = m->body.count;
+    for (i = 0; i < m->n_params; i++) {
+        unsigned n = pch_string(pch, m->params[i]);
+        pch_put(pch, PCH_NAMES, &n, sizeof n);
+    }
+    for (i = 0; i < m->body.count; i++) {
+        const PP_TOKEN *t = &m->body.tok[i];
+        PCH_TOKEN_RECORD tr;
+        tr.kind = t->kind;
+        tr.value = t->kind == TK_ID ? pch_string(pch, t->id)
+                                    : (unsigned) t->num;
+        pch_put(pch, PCH_TOKENS, &tr, sizeof tr);
+    }
+    pch_put(pch, PCH_MACROS, &r, sizeof r);
+}
+
+/* the first token of the main file has just been read */
+static void end_prefix(PREPROC *pp)
+{
+    SCANNER *scan = pp->file->scan;
+    PCH *pch = pp->pch;
+    PCH_KEY_RECORD key;
+    const FILE_INFO *info;
+    size_t i;
+
+    pp->in_prefix = false;
+    pp->pch = NULL;
+    if (pch == NULL || main_scanner(pp) == NULL || scan->start == 0)
+        return;
+
+    for (info = pp->files; info != NULL; info = info->next) {
+        PCH_FILE_RECORD r;
+        struct stat st;
+        if (info->path == pp->file->info->path
+                || stat(info->path, &st) != 0)
+            continue;
+        r.path = pch_string(pch, info->path);
+        r.guard = pch_string(pch, info->guard);
+        r.once = info->once;
+        r.pad = 0;
+        r.size = st.st_size;
+        r.mtime = st.st_mtime;
+        pch_put(pch, PCH_FILES, &r, sizeof r);
+    }
+    for (i = 0; i < pp->n_macros; i++)
+        if (pp->macros[i] != NULL)
+            save_macro(pch, pp->macros[i]);
+
+    key.size = scan->start;
+    key.bol = scan->first;
+    key.hash = hash_string(scan->source, key.size);
+    key.options = options_hash();
+    pch_put(pch, PCH_KEY, &key, sizeof key);
+}
+
+/* the image is saved by the parser, once the prefix has been read */
+void save_preproc(PREPROC *pp, PCH *pch)
+{
+    pp->pch = pch;
+}
+
+/* was the image made from this prefix?  nothing is changed. */
+bool check_preproc(PREPROC *pp, PCH *pch)
+{
+    const PCH_KEY_RECORD *key;
+    const PCH_FILE_RECORD *r;
+    const PCH_MACRO_RECORD *m;
+    SCANNER *scan = main_scanner(pp);
+    unsigned i, n, n_names, n_tokens;
+
+    key = (const PCH_KEY_RECORD*) pch_section(pch, PCH_KEY, sizeof *key, &n);
+    if (n != 1 || scan == NULL || !pp->in_prefix || key->size > scan->size
+            || key->hash != hash_string(scan->source, key->size)
+            || key->options != options_hash())
+        return false;
+    r = (const PCH_FILE_RECORD*) pch_section(pch, PCH_FILES, sizeof *r, &n);
+    for (i = 0; i < n; i++) {
+        const char *path = pch_id(pch, r[i].path);
+        struct stat st;
+        if (path == NULL || stat(path, &st) != 0
+                || st.st_size != r[i].size || st.st_mtime != r[i].mtime)
+            return false;
+    }
+    pch_section(pch, PCH_NAMES, sizeof (unsigned), &n_names);
+    pch_section(pch, PCH_TOKENS, sizeof (PCH_TOKEN_RECORD), &n_tokens);
+    m = (const PCH_MACRO_RECORD*) pch_section(pch, PCH_MACROS, sizeof *m, &n);
+    for (i = 0; i < n; i++) {
+        if (m[i].params > n_names || m[i].body > n_tokens
+                || (m[i].n_params > 0
+                    && (unsigned) m[i].n_params > n_names - m[i].params)
+                || m[i].n_body > n_tokens - m[i].body)
+            return false;
+    }
+    return true;
+}
+
+/* take the state of the image, and go on after the prefix */
+void load_preproc(PREPROC *pp, PCH *pch)
+{
+    const PCH_KEY_RECORD *key;
+    const PCH_FILE_RECORD *fr;
+    const PCH_MACRO_RECORD *mr;
+    const PCH_TOKEN_RECORD *tokens;
+    const unsigned *names;
+    unsigned i, n;
+    int j;
+
+    key = (const PCH_KEY_RECORD*) pch_section(pch, PCH_KEY, sizeof *key, &n);
+    fr = (const PCH_FILE_RECORD*) pch_section(pch, PCH_FILES, sizeof *fr, &n);
+    for (i = 0; i < n; i++) {
+        FILE_INFO *info = find_file_info(pp, pch_id(pch, fr[i].path));
+        info->guard = pch_id(pch, fr[i].guard);
+        info->once = fr[i].once;
+    }
+
+    names = (const unsigned*) pch_section(pch, PCH_NAMES, sizeof *names, &n);
+    tokens = (const PCH_TOKEN_RECORD*) pch_section(pch, PCH_TOKENS,
+                                                   sizeof *tokens, &n);
+    mr = (const PCH_MACRO_RECORD*) pch_section(pch, PCH_MACROS, sizeof *mr,
+                                               &n);
+    for (i = 0; i < n; i++) {
+        MACRO *m = (MACRO*) alloc(sizeof (MACRO));
+        m->name = pch_id(pch, mr[i].name);
+        m->n_params = mr[i].n_params;
+        m->variadic = mr[i].variadic;
+        m->params = NULL;
+        m->busy = false;
+        init_list(&m->body);
+        if (m->n_params > 0) {
+            m->params = (char**) alloc(m->n_params * sizeof (char*));
+            for (j = 0; j < m->n_params; j++)
+                m->params[j] = pch_id(pch, names[mr[i].params + j]);
+        }
+        for (j = 0; j < (int) mr[i].n_body; j++) {
+            const PCH_TOKEN_RECORD *tr = &tokens[mr[i].body + j];
+            PP_TOKEN t;
+            t.kind = (TOKEN) tr->kind;
+            t.flags = 0;
+            t.id = tr->kind == TK_ID ? pch_id(pch, tr->value) : NULL;
+            t.num = tr->kind == TK_ID ? 0 : (int) tr->value;
+            t.loc = pp->file->scan->loc;
+            append_token(&m->body, &t);
+        }
+        set_macro(pp, m->name, m);
+    }
+
+    seek_scanner(pp->file->scan, key->size, key->bol);
+    pp->in_prefix = false;
+}
@@ -0,0 +1,552 @@
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mcc.h"
+
+/*
+ * prescan
+ * a large source is cut into chunks at newlines, and the chunks are
+ * lexed on threads.  the tokens are put together in one array, which
+ * scan_token() then hands out in place of scanning the text.
+ *
+ * the preprocessor still reads the text where it has to: a '#' that
+ * begins a line sends the scanner back to the text for the directive,
+ * and it goes on with the tokens at the next line that is covered by
+ * them.  a chunk that could not be lexed on its own (a comment coming
+ * in from the chunk before, a lexical error to be reported in order)
+ * is lexed again from where it went wrong, or left to the text.
+ */
+
+#define PRESCAN_MIN_SIZE    (1024 * 1024)   /* automatic, below: not worth it */
+#define MAX_LEX_THREADS     64
+#define COMMENT_WINDOW      4096            /* looked at to place a split */
+#define NO_TOKEN            ((size_t) -1)
+
+#define is_space(ch)    ((ch) == ' ' || ((ch) >= '\t' && (ch) <= '\r'))
+
+typedef struct {
+    unsigned char kind;     /* TOKEN */
+    bool first;             /* began a line */
+    size_t start;           /* offset in the source */
+    char *id;
+    int num;                /* in a chunk, the number of an identifier */
+} RAW_TOKEN;
+
+typedef struct {
+    const char *s;
+    unsigned len;
+    unsigned hash;
+} NAME;
+
+/* tokens lexed without a break, and the scanner state after them */
+typedef struct {
+    size_t start, end;      /* source offsets */
+    bool end_bol;
+    size_t first_tok, end_tok;
+} SEGMENT;
+
+struct chunk {
+    COMPILER *cc;           /* not touched by the threads */
+    size_t start, end;      /* source offsets */
+    const char *source;
+    const CHUNK *next;      /* a fix-up stops when it meets its tokens */
+    SCANNER *scan;
+    jmp_buf fail;
+    RAW_TOKEN *tok;
+    size_t n_tok;
+    size_t tok_size;
+    size_t skip;            /* tokens taken over by a fix-up */
+    SEGMENT *run;
+    int n_run;
+    int run_size;
+    NAME *names;            /* identifiers, numbered in the chunk */
+    unsigned n_names;
+    unsigned *slot;         /* hash table of names, 0: empty */
+    unsigned slot_size;
+    char **ids;             /* names, interned */
+    bool in_comment;        /* ends in a comment */
+    bool joined;            /* a fix-up met next->tok[join] */
+    size_t join;
+    RAW_TOKEN *dest;        /* the array ... */
+    size_t out;             /* ... and the index of tok[skip] in it */
+};
+
+struct prescan {
+    RAW_TOKEN *tok;
+    size_t n_tok;
+    SEGMENT *seg;
+    int n_seg;
+    int cur;                /* segment of the next token */
+    size_t next;            /* NO_TOKEN while reading the text */
+};
+
+static int s_lex_threads = 0;       /* 0: one per processor, large files */
+
+void set_lex_threads(int n)
+{
+    s_lex_threads = n < MAX_LEX_THREADS ? n : MAX_LEX_THREADS;
+}
+
+/*
+ * chunks
+ */
+unsigned chunk_name(CHUNK *c, const char *s, size_t len)
+{
+    unsigned hash = hash_string(s, len);
+    unsigned i;
+
+    if ((c->n_names + 1) * 2 > c->slot_size) {
+        unsigned size = c->slot_size ? c->slot_size * 2 : 1024;
+        unsigned *slot = (unsigned*) alloc(size * sizeof (unsigned));
+        NAME *names = (NAME*) alloc(size / 2 * sizeof (NAME));
+        memset(slot, 0, size * sizeof (unsigned));
+        memcpy(names, c->names, c->n_names * sizeof (NAME));
+        for (i = 0; i < c->n_names; i++) {
+            unsigned j = names[i].hash & (size - 1);
+            while (slot[j] != 0)
+                j = (j + 1) & (size - 1);
+            slot[j] = i + 1;
+        }
+        free(c->slot);
+        free(c->names);
+        c->slot = slot;
+        c->names = names;
+        c->slot_size = size;
+    }
+    for (i = hash & (c->slot_size - 1); c->slot[i] != 0;
+            i = (i + 1) & (c->slot_size - 1)) {
+        const NAME *n = &c->names[c->slot[i] - 1];
+        if (n->hash == hash && n->len == len && memcmp(n->s, s, len) == 0)
+            return c->slot[i] - 1;
+    }
+    c->names[c->n_names].s = s;
+    c->names[c->n_names].len = len;
+    c->names[c->n_names].hash = hash;
+    c->slot[i] = ++c->n_names;
+    return c->n_names - 1;
+}
+
+void chunk_failed(CHUNK *c)
+{
+    longjmp(c->fail, 1);
+}
+
+static void add_run(CHUNK *c, size_t start, bool bol)
+{
+    SEGMENT *r;
+
+    if (c->n_run == c->run_size) {
+        c->run_size = c->run_size ? c->run_size * 2 : 4;
+        r = (SEGMENT*) alloc(c->run_size * sizeof (SEGMENT));
+        memcpy(r, c->run, c->n_run * sizeof (SEGMENT));
+        free(c->run);
+        c->run = r;
+    }
+    r = &c->run[c->n_run++];
+    r->start = r->end = start;
+    r->end_bol = bol;
+    r->first_tok = r->end_tok = c->n_tok;
+}
+
+static CHUNK *new_chunk(COMPILER *cc, const char *source, size_t start,
+                        size_t end, bool bol)
+{
+    CHUNK *c = (CHUNK*) alloc(sizeof (CHUNK));
+    memset(c, 0, sizeof (CHUNK));
+    c->cc = cc;
+    c->source = source;
+    c->start = start;
+    c->end = end;
+    add_run(c, start, bol);
+    return c;
+}
+
+static void free_chunk(CHUNK *c)
+{
+    close_scanner(c->scan);
+    free(c->tok);
+    free(c->run);
+    free(c->names);
+    free(c->slot);
+    free(c->ids);
+    free(c);
+}
+
+static void add_token(CHUNK *c, TOKEN tk)
+{
+    const SCANNER *scan = c->scan;
+    RAW_TOKEN *t;
+    SEGMENT *r;
+
+    if (c->n_tok == c->tok_size) {
+        c->tok_size = c->tok_size ? c->tok_size * 2 : 1024;
+        t = (RAW_TOKEN*) alloc(c->tok_size * sizeof (RAW_TOKEN));
+        memcpy(t, c->tok, c->n_tok * sizeof (RAW_TOKEN));
+        free(c->tok);
+        c->tok = t;
+    }
+    t = &c->tok[c->n_tok++];
+    t->kind = tk;
+    t->first = scan->first;
+    t->start = scan->start;
+    t->id = NULL;
+    t->num = scan->num;
+
+    r = &c->run[c->n_run - 1];
+    r->end = scan->offset + scan->current - 1;
+    r->end_bol = scan->bol;
+    r->end_tok = c->n_tok;
+}
+
+/* does the token just scanned begin where c->next has the same token? */
+static bool join_next(CHUNK *c, TOKEN tk)
+{
+    const CHUNK *next = c->next;
+    const SCANNER *scan = c->scan;
+    size_t j = c->join;
+
+    while (j < next->n_tok && next->tok[j].start < (size_t) scan->start)
+        j++;
+    c->join = j;
+    return j < next->n_tok && next->tok[j].start == (size_t) scan->start
+            && next->tok[j].kind == tk && next->tok[j].first == scan->first;
+}
+
+/*
+ * after a lexical error, go on at the next directive, as the text is
+ * read when the error is in a group that is skipped.  false at the end
+ * of the chunk.
+ */
+static bool resync(CHUNK *c)
+{
+    SCANNER *scan = c->scan;
+
+    if (scan->current > scan->size) {
+        c->in_comment = true;
+        return false;
+    }
+    seek_scanner(scan, scan->start - scan->offset, scan->first);
+    if (setjmp(c->fail) != 0) {
+        c->in_comment = true;
+        return false;
+    }
+    skip_group(scan);
+    if (scan->ch == '\0')
+        return false;
+    add_run(c, scan->offset + scan->current - 1, scan->bol);
+    return true;
+}
+
+/* lex [start, end) of the source, from the state at the end of run[0] */
+static void lex_chunk(CHUNK *c)
+{
+    SCANNER *scan;
+    TOKEN tk;
+
+    scan = open_scanner_at(c->cc, 0, c->source + c->start, c->end - c->start);
+    scan->offset = c->start;
+    scan->bol = c->run[0].end_bol;
+    scan->chunk = c;
+    c->scan = scan;
+    for (;;) {
+        if (setjmp(c->fail) == 0) {
+            while ((tk = scan_token(scan)) != TK_EOF) {
+                if (c->next != NULL && join_next(c, tk)) {
+                    SEGMENT *r = &c->run[c->n_run - 1];
+                    r->end = scan->start;
+                    r->end_bol = scan->first;
+                    c->joined = true;
+                    return;
+                }
+                add_token(c, tk);
+            }
+            if (scan->current > scan->size) {   /* not at a '\0' in it */
+                SEGMENT *r = &c->run[c->n_run - 1];
+                r->end = c->end;
+                r->end_bol = true;
+            }
+            return;
+        }
+        if (!resync(c))
+            return;
+    }
+}
+
+static void *lex_thread(void *arg)
+{
+    lex_chunk((CHUNK*) arg);
+    return NULL;
+}
+
+/* the tokens of a chunk, put in their place in the array */
+static void *copy_thread(void *arg)
+{
+    CHUNK *c = (CHUNK*) arg;
+    size_t i;
+
+    for (i = c->skip; i < c->n_tok; i++) {
+        RAW_TOKEN *t = &c->dest[c->out + i - c->skip];
+        *t = c->tok[i];
+        if (t->kind == TK_ID) {
+            t->id = c->ids[t->num];
+            t->num = 0;
+        }
+    }
+    return NULL;
+}
+
+/* run fn on each chunk, the first one on this thread */
+static void run_threads(CHUNK **c, int n, void *(*fn)(void*))
+{
+    pthread_t thread[MAX_LEX_THREADS * 2];
+    bool started[MAX_LEX_THREADS * 2];
+    int i;
+
+    for (i = 1; i < n; i++)
+        started[i] = pthread_create(&thread[i], NULL, fn, c[i]) == 0;
+    fn(c[0]);
+    for (i = 1; i < n; i++) {
+        if (started[i])
+            pthread_join(thread[i], NULL);
+        else
+            fn(c[i]);
+    }
+}
+
+/*
+ * a newline at or after target, not in a comment as far as can be told
+ * without lexing: the next comment mark after it must not be a "*" "/".
+ */
+static size_t split_point(const char *s, size_t target, size_t size)
+{
+    size_t p = target;
+
+    for (;;) {
+        const char *nl = memchr(s + p, '\n', size - p);
+        const char *q, *end;
+        if (nl == NULL)
+            return size;
+        p = nl - s + 1;
+        end = s + (size - p < COMMENT_WINDOW ? size : p + COMMENT_WINDOW);
+        for (q = s + p; (q = memchr(q, '*', end - q)) != NULL; q++) {
+            if (q > s + p && q[-1] == '/')
+                return p;
+            if (q + 1 < end && q[1] == '/')
+                break;
+        }
+        if (q == NULL)
+            return p;
+        p = q + 2 - s;
+    }
+}
+
+/*
+ * the chunk after one that ran into its end in a comment is lexed again
+ * from where the tokens of the first one stop, until it meets a token
+ * of its own.
+ */
+static CHUNK *fix_chunk(const CHUNK *prev, const CHUNK *c)
+{
+    const SEGMENT *r = &prev->run[prev->n_run - 1];
+    CHUNK *fix = new_chunk(c->cc, c->source, r->end, c->end, r->end_bol);
+    fix->next = c;
+    lex_chunk(fix);
+    return fix;
+}
+
+static void put_tokens(PRESCAN *ps, CHUNK **used, int n)
+{
+    CHUNK *c;
+    int i;
+    unsigned j;
+
+    for (i = 0; i < n; i++) {
+        c = used[i];
+        c->out = ps->n_tok;
+        ps->n_tok += c->n_tok - c->skip;
+        c->ids = (char**) alloc((c->n_names + 1) * sizeof (char*));
+        for (j = 0; j < c->n_names; j++)
+            c->ids[j] = intern_n(c->cc, c->names[j].s, c->names[j].len);
+    }
+    ps->tok = (RAW_TOKEN*) alloc((ps->n_tok + 1) * sizeof (RAW_TOKEN));
+    for (i = 0; i < n; i++)
+        used[i]->dest = ps->tok;
+    run_threads(used, n, copy_thread);
+}
+
+/* the runs of all chunks, joined when they touch */
+static void put_segments(PRESCAN *ps, CHUNK **used, int n)
+{
+    int i, j, size = 0;
+
+    for (i = 0; i < n; i++)
+        size += used[i]->n_run;
+    ps->seg = (SEGMENT*) alloc(size * sizeof (SEGMENT));
+    ps->n_seg = 0;
+    for (i = 0; i < n; i++) {
+        const CHUNK *c = used[i];
+        for (j = 0; j < c->n_run; j++) {
+            SEGMENT r = c->run[j];
+            if (r.end_tok <= c->skip && c->skip > 0)
+                continue;
+            if (r.first_tok < c->skip) {
+                r.first_tok = c->skip;
+                r.start = c->tok[c->skip].start;
+            }
+            r.first_tok += c->out - c->skip;
+            r.end_tok += c->out - c->skip;
+            if (ps->n_seg > 0 && ps->seg[ps->n_seg - 1].end == r.start) {
+                SEGMENT *s = &ps->seg[ps->n_seg - 1];
+                s->end = r.end;
+                s->end_bol = r.end_bol;
+                s->end_tok = r.end_tok;
+            } else {
+                ps->seg[ps->n_seg++] = r;
+            }
+        }
+    }
+}
+
+/*
+ * lex the source on threads, for scan_token() to take the tokens from.
+ * only a complete source is prescanned.
+ */
+void prescan(SCANNER *scan)
+{
+    CHUNK *chunk[MAX_LEX_THREADS], *used[MAX_LEX_THREADS * 2];
+    int n = s_lex_threads, n_chunk = 0, n_used = 0;
+    size_t start = 0;
+    PRESCAN *ps;
+    int i;
+
+    if (n == 0) {
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+        if (n > MAX_LEX_THREADS)
+            n = MAX_LEX_THREADS;
+        if (scan->size < PRESCAN_MIN_SIZE)
+            return;
+    }
+    if (n < 2 || scan->fd >= 0 || scan->offset != 0 || scan->prescan != NULL
+            || is_debug(DEBUG_SCANNER))
+        return;
+
+    while (start < scan->size && n_chunk < n) {
+        size_t end = n_chunk == n - 1 ? scan->size
+                        : split_point(scan->source,
+                                start + (scan->size - start) / (n - n_chunk),
+                                scan->size);
+        chunk[n_chunk++] = new_chunk(scan->cc, scan->source, start, end,
+                                         true);
+        start = end;
+    }
+    if (n_chunk < 2) {
+        for (i = 0; i < n_chunk; i++)
+            free_chunk(chunk[i]);
+        return;
+    }
+    run_threads(chunk, n_chunk, lex_thread);
+    for (i = 0; i < n_chunk; i++) {
+        CHUNK *c = chunk[i];
+        if (n_used > 0 && used[n_used - 1]->in_comment) {
+            CHUNK *fix = fix_chunk(used[n_used - 1], c);
+            used[n_used++] = fix;
+            if (!fix->joined)
+                continue;       /* c was lexed again as a whole */
+            c->skip = fix->join;
+        }
+        used[n_used++] = c;
+    }
+
+    ps = (PRESCAN*) alloc(sizeof (PRESCAN));
+    ps->n_tok = 0;
+    put_tokens(ps, used, n_used);
+    put_segments(ps, used, n_used);
+    ps->cur = 0;
+    ps->next = NO_TOKEN;
+    scan->prescan = ps;
+    for (i = 0; i < n_used; i++)    /* the fix-ups, before what they see */
+        if (used[i]->next != NULL)
+            free_chunk(used[i]);
+    for (i = 0; i < n_chunk; i++)
+        free_chunk(chunk[i]);
+}
+
+void free_prescan(PRESCAN *ps)
+{
+    if (ps == NULL)
+        return;
+    free(ps->tok);
+    free(ps->seg);
+    free(ps);
+}
+
+/* first token of segment s at or after p */
+static size_t find_token(const PRESCAN *ps, int s, size_t p)
+{
+    size_t lo = ps->seg[s].first_tok, hi = ps->seg[s].end_tok;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ps->tok[mid].start < p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * the tokens are taken up again at the beginning of a line in a segment,
+ * when the scanner has left them for a directive or at a segment end.
+ * a directive has been read to its end by then.
+ */
+static bool resume(PRESCAN *ps, SCANNER *scan)
+{
+    size_t p = scan->current - (is_space(scan->ch) ? 0 : 1);
+    int lo = 0, hi = ps->n_seg;
+
+    if (!scan->bol && scan->ch != '\n')
+        return false;
+    while (lo < hi) {           /* the last segment starting at or before p */
+        int mid = lo + (hi - lo) / 2;
+        if (ps->seg[mid].start <= p)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 || p >= ps->seg[lo - 1].end)
+        return false;
+    ps->cur = lo - 1;
+    ps->next = find_token(ps, lo - 1, p);
+    return true;
+}
+
+/* the next token from the prescan; false to scan it from the text */
+bool prescanned_token(SCANNER *scan, TOKEN *tk)
+{
+    PRESCAN *ps = scan->prescan;
+    const RAW_TOKEN *t;
+
+    for (;;) {
+        const SEGMENT *s;
+        if (ps->next == NO_TOKEN && !resume(ps, scan))
+            return false;
+        s = &ps->seg[ps->cur];
+        if (ps->next < s->end_tok)
+            break;
+        seek_scanner(scan, s->end, s->end_bol);
+        ps->next = NO_TOKEN;
+    }
+    t = &ps->tok[ps->next++];
+    scan->first = t->first;
+    scan->bol = false;
+    scan->start = t->start;
+    scan->id = t->id;
+    scan->num = t->num;
+    if (t->kind == TK_HASH && t->first) {
+        seek_scanner(scan, t->start + 1, false);
+        ps->next = NO_TOKEN;
+    }
+    *tk = (TOKEN) t->kind;
+    return true;
+}
@@ -1,320 +1,894 @@
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "mcc.h"
 
-/* string buffer / number parse buffer */
-#define MAX_BUFFER  256
+/* read size for streamed input */
+#define SCANNER_CHUNK_SIZE  (64 * 1024)
+
+/* scan->mark when no lexeme is being scanned */
+#define NO_MARK     ((size_t) -1)
+
+/*
+ * identifier table
+ * open addressing (linear probing) on a precomputed hash.  the strings
+ * themselves live in a chunked arena, so interned pointers never move
+ * and pointer equality can be used to compare identifiers.
+ */
+#define INTERN_INIT_SIZE    1024        /* must be power of 2 */
+#define INTERN_CHUNK_SIZE   (64 * 1024)
 
 typedef struct ident {
-    struct ident *next;
-    char *id;
+    const char *id;
+    unsigned hash;
+    int len;
 } IDENT;
 
-static IDENT *s_ident_top = NULL;
+typedef struct ident_chunk {
+    struct ident_chunk *next;
+    size_t used;
+    size_t size;
+    char text[1];
+} IDENT_CHUNK;
 
-char* new_ident(const char *s)
+unsigned hash_string(const char *s, size_t len)
 {
-    IDENT *p = (IDENT*) alloc(sizeof (IDENT));
-    p->id = strdup(s);
-    p->next = s_ident_top;
-    s_ident_top = p;
-    return p->id;
+    unsigned h = 2166136261u;   /* FNV-1a */
+    size_t i;
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 16777619u;
+    }
+    return h;
 }
 
-void print_ident(void)
+/*
+ * every string is preceded by its identifier number, so ident_number()
+ * needs no lookup.
+ */
+static char *store_ident(COMPILER *cc, const char *s, size_t len,
+                         unsigned num)
 {
-    IDENT *id;
-    printf("print ident [\n");
-    for (id = s_ident_top; id != NULL; id = id->next)
-        printf(" %p:%s\n", id, id->id);
-    printf("]\n");
+    IDENT_CHUNK *chunk = cc->ident_chunk;
+    size_t need = sizeof (unsigned) + len + 1;
+    char *p;
+
+    if (chunk == NULL || chunk->used + need > chunk->size) {
+        size_t size = INTERN_CHUNK_SIZE;
+        if (need > size)
+            size = need;
+        chunk = (IDENT_CHUNK*) alloc(sizeof (IDENT_CHUNK) + size);
+        chunk->next = cc->ident_chunk;
+        chunk->used = 0;
+        chunk->size = size;
+        cc->ident_chunk = chunk;
+    }
+    p = chunk->text + chunk->used;
+    memcpy(p, &num, sizeof (unsigned));
+    p += sizeof (unsigned);
+    memcpy(p, s, len);
+    p[len] = '\0';
+    chunk->used += need;
+
+    if (num >= cc->ident_list_size) {
+        char **list;
+        cc->ident_list_size = cc->ident_list_size ? cc->ident_list_size * 2
+                                              : INTERN_INIT_SIZE;
+        list = (char**) alloc(cc->ident_list_size * sizeof (char*));
+        memcpy(list, cc->ident_list, num * sizeof (char*));
+        free(cc->ident_list);
+        cc->ident_list = list;
+    }
+    cc->ident_list[num] = p;
+    return p;
 }
 
-char *intern(const char *s)
+static void grow_ident_table(COMPILER *cc)
 {
-    IDENT *id = s_ident_top;
-/*
-    print_ident();
-*/
-    for (; id != NULL; id = id->next)
-        if (strcmp(id->id, s) == 0)
-            return id->id;
-    return new_ident(s);
+    IDENT *old = cc->ident_table;
+    size_t old_size = cc->ident_size;
+    size_t i;
+
+    cc->ident_size = old_size ? old_size * 2 : INTERN_INIT_SIZE;
+    cc->ident_table = (IDENT*) alloc(cc->ident_size * sizeof (IDENT));
+    memset(cc->ident_table, 0, cc->ident_size * sizeof (IDENT));
+    for (i = 0; i < old_size; i++) {
+        size_t j;
+        if (old[i].id == NULL)
+            continue;
+        j = old[i].hash & (cc->ident_size - 1);
+        while (cc->ident_table[j].id != NULL)
+            j = (j + 1) & (cc->ident_size - 1);
+        cc->ident_table[j] = old[i];
+    }
+    free(old);
 }
 
-SCANNER *open_scanner_text(const char *filename, const char *text)
+char *intern_n(COMPILER *cc, const char *s, size_t len)
+{
+    unsigned hash = hash_string(s, len);
+    IDENT *p;
+    size_t i;
+
+    if ((cc->ident_count + 1) * 2 > cc->ident_size)
+        grow_ident_table(cc);
+    i = hash & (cc->ident_size - 1);
+    for (;;) {
+        p = &cc->ident_table[i];
+        if (p->id == NULL)
+            break;
+        if (p->hash == hash && p->len == len && memcmp(p->id, s, len) == 0)
+            return (char*) p->id;
+        i = (i + 1) & (cc->ident_size - 1);
+    }
+    p->id = store_ident(cc, s, len, cc->ident_count);
+    p->hash = hash;
+    p->len = len;
+    cc->ident_count++;
+    return (char*) p->id;
+}
+
+char *intern(COMPILER *cc, const char *s)
+{
+    return intern_n(cc, s, strlen(s));
+}
+
+/* identifiers are numbered densely in the order they were interned */
+unsigned ident_number(const char *id)
+{
+    unsigned num;
+    memcpy(&num, id - sizeof (unsigned), sizeof (unsigned));
+    return num;
+}
+
+char *ident_string(COMPILER *cc, unsigned num)
+{
+    return cc->ident_list[num];
+}
+
+void print_intern_stats(COMPILER *cc)
+{
+    size_t i, probe, total_probe = 0, max_probe = 0, arena = 0;
+    IDENT_CHUNK *chunk;
+
+    for (i = 0; i < cc->ident_size; i++) {
+        if (cc->ident_table[i].id == NULL)
+            continue;
+        probe = (i - cc->ident_table[i].hash) & (cc->ident_size - 1);
+        total_probe += probe;
+        if (probe > max_probe)
+            max_probe = probe;
+    }
+    for (chunk = cc->ident_chunk; chunk != NULL; chunk = chunk->next)
+        arena += chunk->used;
+    printf("intern: %lu ids, %lu slots, load %.2f, "
+            "probe avg %.2f max %lu, arena %lu bytes\n",
+            (unsigned long) cc->ident_count, (unsigned long) cc->ident_size,
+            cc->ident_size ? (double) cc->ident_count / cc->ident_size : 0.0,
+            cc->ident_count ? (double) total_probe / cc->ident_count : 0.0,
+            (unsigned long) max_probe, (unsigned long) arena);
+}
+
+void free_idents(COMPILER *cc)
+{
+    IDENT_CHUNK *chunk;
+
+    while ((chunk = cc->ident_chunk) != NULL) {
+        cc->ident_chunk = chunk->next;
+        free(chunk);
+    }
+    free(cc->ident_table);
+    free(cc->ident_list);
+    cc->ident_table = NULL;
+    cc->ident_list = NULL;
+    cc->ident_size = cc->ident_count = cc->ident_list_size = 0;
+}
+
+/* a source of the given size, -1 when it is streamed */
+static SCANNER *new_scanner(COMPILER *cc, const char *filename,
+                            long long size)
 {
     SCANNER *s = (SCANNER*) alloc(sizeof (SCANNER));
-    s->source = text;
-    s->size = strlen(text);
+    s->cc = cc;
+    s->source = NULL;
+    s->size = 0;
     s->current = 0;
+    s->mark = NO_MARK;
     s->ch = ' ';
-    s->pos.line = 1;
-    s->pos.filename = filename;
+    s->base = 0;
+    s->range = 1;
+    if (filename != NULL)
+        s->base = add_source(cc, filename, size, &s->range);
+    s->loc = s->base;
     s->num = 0;
     s->id = NULL;
+    s->bol = true;
+    s->first = false;
+    s->start = 0;
+    s->pp = NULL;
+    s->prescan = NULL;
+    s->chunk = NULL;
+    s->fd = -1;
+    s->offset = 0;
+    s->buffer = NULL;
+    s->buffer_size = 0;
+    s->map = NULL;
+    s->map_size = 0;
     return s;
 }
 
-SCANNER *open_scanner(const char *filename)
+/*
+ * every source is followed by two '\0': the sentinel at source[size],
+ * and one more so next_char() may step past the sentinel at the end of
+ * input, keeping the current character at source[current-1].
+ */
+static SCANNER *copy_source(COMPILER *cc, const char *filename,
+                            const char *text, size_t size)
 {
-    FILE *fp;
-    size_t size;
-    char *s;
+    SCANNER *s = new_scanner(cc, filename, size);
+    s->buffer = (char*) alloc(size + 2);
+    memcpy(s->buffer, text, size);
+    s->buffer[size] = s->buffer[size+1] = '\0';
+    s->buffer_size = size;
+    s->source = s->buffer;
+    s->size = size;
+    return s;
+}
 
-    fp = fopen(filename, "r");
-    if (fp == NULL)
-        return NULL;
+SCANNER *open_scanner_text(COMPILER *cc, const char *filename,
+                           const char *text)
+{
+    SCANNER *s = copy_source(cc, filename, text, strlen(text));
+    set_source_text(cc, s->base, s->source, 0, s->size);
+    return s;
+}
 
-    if (fseek(fp, 0, SEEK_END) != 0)
-        return NULL;
+/*
+ * text that is not a source of its own, such as the spelling of a pasted
+ * token: all of it is at loc.
+ */
+SCANNER *open_scanner_at(COMPILER *cc, SRCLOC loc, const char *text,
+                         size_t len)
+{
+    SCANNER *s = copy_source(cc, NULL, text, len);
+    s->base = s->loc = loc;
+    return s;
+}
 
-    size = ftell(fp);
+/*
+ * map the file followed by at least one anonymous zero page, so the
+ * scanner always finds the '\0' sentinels after source[size] even when
+ * the file size is a multiple of the page size.
+ */
+static SCANNER *map_source(COMPILER *cc, const char *filename, int fd,
+                           size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t map_size = (size + page - 1) / page * page + page;
+    char *base;
+    SCANNER *s;
 
-    if (fseek(fp, 0, SEEK_SET) != 0)
+    base = mmap(NULL, map_size, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+    if (mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)
+            == MAP_FAILED) {
+        munmap(base, map_size);
         return NULL;
+    }
+    s = new_scanner(cc, filename, size);
+    s->source = base;
+    s->size = size;
+    s->map = base;
+    s->map_size = map_size;
+    set_source_text(cc, s->base, s->source, 0, s->size);
+    return s;
+}
+
+/*
+ * pipes, character devices and anything mmap refuses are streamed
+ * through a buffer, refilled by next_char() when it reaches the
+ * sentinel.
+ */
+static SCANNER *stream_source(COMPILER *cc, const char *filename, int fd)
+{
+    SCANNER *s = new_scanner(cc, filename, -1);
+    s->buffer_size = SCANNER_CHUNK_SIZE;
+    s->buffer = (char*) alloc(s->buffer_size + 2);
+    s->buffer[0] = s->buffer[1] = '\0';
+    s->source = s->buffer;
+    s->fd = fd;
+    return s;
+}
+
+SCANNER *open_scanner(COMPILER *cc, const char *filename)
+{
+    struct stat st;
+    SCANNER *s = NULL;
+    int fd;
+
+    if (strcmp(filename, "-") == 0)
+        return stream_source(cc, "<stdin>", STDIN_FILENO);
 
-    s = (char*) alloc((size+1) * sizeof (char));
-    if (fread(s, size, 1, fp) != 1) {
-        fclose(fp);
-        free(s);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
         return NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        s = map_source(cc, filename, fd, st.st_size);
+    if (s != NULL) {
+        close(fd);
+        return s;
     }
-    s[size] = '\0';
-    fclose(fp);
-    return open_scanner_text(filename, s);
+    return stream_source(cc, filename, fd);
 }
 
 bool close_scanner(SCANNER *s)
 {
     if (s == NULL)
         return false;
-/*
-    print_ident();
-*/
+    free_preproc(s->pp);
+    free_prescan(s->prescan);
+    if (s->range > 1) {
+        drop_source_text(s->cc, s->base, s->offset + s->size);
+        set_source_text(s->cc, s->base, NULL, 0, 0);
+    }
+    if (s->map)
+        munmap(s->map, s->map_size);
+    if (s->fd > STDIN_FILENO)
+        close(s->fd);
+    free(s->buffer);
     free(s);
     return true;
 }
 
-static int is_white(int ch)
+/*
+ * called when next_char() reads the sentinel at source[size].
+ * the lexeme being scanned from source[mark] is moved to the front of
+ * the buffer, so it stays contiguous; the buffer grows when a single
+ * lexeme fills it.
+ * returns the next character, or '\0' at the end of input.
+ */
+static int fill_buffer(SCANNER *scan)
+{
+    size_t keep = 0;
+    ssize_t n;
+
+    if (scan->fd < 0) {
+        scan->current = scan->size + 1;     /* on the second '\0' */
+        return '\0';
+    }
+    if (scan->mark != NO_MARK)
+        keep = scan->size - scan->mark;
+    drop_source_text(scan->cc, scan->base, scan->offset + scan->size - keep);
+    if (keep > 0) {
+        memmove(scan->buffer, scan->buffer + scan->mark, keep);
+        scan->mark = 0;
+    }
+    if (keep == scan->buffer_size) {
+        char *p = (char*) alloc(scan->buffer_size * 2 + 2);
+        memcpy(p, scan->buffer, keep);
+        free(scan->buffer);
+        scan->buffer = p;
+        scan->buffer_size *= 2;
+        scan->source = p;
+    }
+    scan->offset += scan->size - keep;
+    set_source_text(scan->cc, scan->base, scan->buffer, scan->offset, keep);
+    do {
+        n = read(scan->fd, scan->buffer + keep, scan->buffer_size - keep);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        scan->size = keep;
+        scan->buffer[keep] = scan->buffer[keep+1] = '\0';
+        scan->current = keep + 1;
+        if (scan->fd > STDIN_FILENO)
+            close(scan->fd);
+        scan->fd = -1;
+        if (n < 0)
+            error(scan->cc, scan_loc(scan), "read error");
+        return '\0';
+    }
+    scan->size = keep + n;
+    set_source_text(scan->cc, scan->base, scan->buffer, scan->offset,
+                    scan->size);
+    scan->buffer[scan->size] = scan->buffer[scan->size+1] = '\0';
+    scan->current = keep + 1;
+    return scan->buffer[keep];
+}
+
+struct keyword {
+    const char *name;
+    int len;
+    TOKEN token;
+};
+
+#include "lextab.h"
+
+/*
+ * past the first range of a streamed source, srcloc.c gives more.
+ * text that is not a source of its own is all at its base.
+ */
+static SRCLOC offset_loc(const SCANNER *scan, long long offset)
 {
-    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r'
-        || ch == '\f' || ch == '\v';
+    if (offset <= 0)
+        return scan->base;
+    if (offset < scan->range)
+        return scan->base + (unsigned) offset;
+    if (scan->range == 1)
+        return scan->base;
+    return source_loc(scan->cc, scan->base, offset);
 }
 
-static int is_alpha(int ch)
+#define is_white(ch)    (s_char_flags[(unsigned char) (ch)] & CF_WHITE)
+#define is_alpha(ch)    (s_char_flags[(unsigned char) (ch)] & CF_ALPHA)
+#define is_digit(ch)    (s_char_flags[(unsigned char) (ch)] & CF_DIGIT)
+#define is_alnum(ch)    (s_char_flags[(unsigned char) (ch)] \
+                            & (CF_ALPHA | CF_DIGIT))
+
+/* a scanner lexing a chunk on a thread gives up instead, see prescan.c */
+static void scan_error(SCANNER *scan, const char *s, ...)
 {
-    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+    va_list ap;
+
+    if (scan->chunk != NULL)
+        chunk_failed(scan->chunk);
+    va_start(ap, s);
+    verror(scan->cc, scan_loc(scan), s, ap);
+    va_end(ap);
 }
 
-static int is_alnum(int ch)
+static void scan_warning(SCANNER *scan, const char *s, ...)
 {
-    return is_alpha(ch) || isdigit(ch);
+    va_list ap;
+
+    if (scan->chunk != NULL)
+        chunk_failed(scan->chunk);
+    va_start(ap, s);
+    vwarning(scan->cc, scan_loc(scan), s, ap);
+    va_end(ap);
 }
 
 static int next_char(SCANNER *scan)
 {
     if (scan->ch == '\n')
-        scan->pos.line++;
+        scan->bol = true;
     scan->ch = scan->source[scan->current++];
+    if (scan->ch == '\0' && scan->current > scan->size)
+        scan->ch = fill_buffer(scan);
 
-    if (is_debug("scanner"))
-        printf("%s(%d):next_char: '%c'\n",
-                scan->pos.filename, scan->pos.line, scan->ch);
+    if (is_debug(DEBUG_SCANNER)) {
+        POS pos = decode_loc(scan->cc, scan_loc(scan));
+        printf("%s(%d):next_char: '%c'\n", pos.filename, pos.line, scan->ch);
+    }
 
     return scan->ch;
 }
 
-static TOKEN scan_id(SCANNER *scan)
+/*
+ * keywords: one probe into s_keywords and one compare.
+ * KEYWORD_HASH is made perfect for token.def by mklex.
+ */
+static TOKEN lookup_keyword(const char *s, int len)
 {
-    char buffer[MAX_IDENT+1];
-    int i = 0;
-    while (is_alnum(scan->ch)) {
-        if (i < MAX_IDENT)
-            buffer[i++] = scan->ch;
-        next_char(scan);
-    }
-    buffer[i] = '\0';
-    /*TODO keywords */
-    if (strcmp(buffer, "static") == 0) return TK_STATIC;
-    if (strcmp(buffer, "extern") == 0) return TK_EXTERN;
-    if (strcmp(buffer, "void") == 0) return TK_VOID;
-    if (strcmp(buffer, "int") == 0) return TK_INT;
-    if (strcmp(buffer, "if") == 0) return TK_IF;
-    if (strcmp(buffer, "else") == 0) return TK_ELSE;
-    if (strcmp(buffer, "while") == 0) return TK_WHILE;
-    if (strcmp(buffer, "for") == 0) return TK_FOR;
-    if (strcmp(buffer, "continue") == 0) return TK_CONTINUE;
-    if (strcmp(buffer, "break") == 0) return TK_BREAK;
-    if (strcmp(buffer, "return") == 0) return TK_RETURN;
-    scan->id = intern(buffer);
+    const struct keyword *kw;
+    kw = &s_keywords[KEYWORD_HASH(len, (unsigned char) s[0],
+                                       (unsigned char) s[len-1])];
+    if (kw->len == len && memcmp(kw->name, s, len) == 0)
+        return kw->token;
     return TK_ID;
 }
 
-static TOKEN scan_num(SCANNER *scan)
+/*
+ * move to q, found by one of the bulk skipping kernels at or after the
+ * current character, which is at source[current-1].
+ * lines is the number of newlines passed over.
+ */
+static void skip_to(SCANNER *scan, const char *q, int lines)
 {
-    char buffer[MAX_BUFFER+1];
-    int i = 0;
-    while (isdigit(scan->ch)) {
-        if (i < MAX_BUFFER)
-            buffer[i++] = scan->ch;
+    if (lines > 0)
+        scan->bol = true;
+    scan->ch = ' ';     /* consumed, and not a newline */
+    scan->current = q - scan->source;
+    next_char(scan);
+}
+
+static void skip_space(SCANNER *scan)
+{
+    while (is_white(scan->ch)) {
+        int lines = 0;
+        const char *q;
         next_char(scan);
+        if (is_debug(DEBUG_SCANNER) || !is_white(scan->ch))
+            continue;
+        q = skip_white(scan->source + scan->current - 1,
+                       scan->source + scan->size, &lines);
+        skip_to(scan, q, lines);
+    }
+}
+
+void skip_rest_of_line(SCANNER *scan)
+{
+    while (scan->ch != '\0' && scan->ch != '\n') {
+        if (is_debug(DEBUG_SCANNER)) {
+            next_char(scan);
+            continue;
+        }
+        skip_to(scan, skip_to_newline(scan->source + scan->current - 1,
+                                      scan->source + scan->size), 0);
     }
-    buffer[i] = '\0';
-    scan->num = atoi(buffer);
-    /* TODO unsigned, long, float, double */
-    return TK_INT_LIT;
 }
 
+/* a comment is one space: it does not end the line it started on */
 static void skip_comment(SCANNER *scan)
 {
+    bool bol = scan->bol;
+
     next_char(scan);    /* skip '*' */
     for (;;) {
-        if (scan->ch == EOF) {
-            error(&scan->pos, "unterminated comment");
+        if (scan->ch == '\0') {
+            scan_error(scan, "unterminated comment");
             return;
         }
-        if (scan->ch != '*')
-            next_char(scan);
-        else if (next_char(scan) == '/') {
+        if (scan->ch != '*') {
+            int lines = 0;
+            const char *q;
+            if (is_debug(DEBUG_SCANNER)) {
+                next_char(scan);
+                continue;
+            }
+            q = skip_to_comment_end(scan->source + scan->current - 1,
+                                    scan->source + scan->size, &lines);
+            skip_to(scan, q, lines);
+        } else if (next_char(scan) == '/') {
             next_char(scan);
             break;
         }
     }
+    scan->bol = bol;
+}
+
+/*
+ * is c the character after the current one?  at the end of a streamed
+ * buffer the current character is kept as a lexeme across the refill.
+ */
+static bool peek_char(SCANNER *scan, int c)
+{
+    if (scan->current >= scan->size && scan->fd >= 0) {
+        scan->mark = scan->current - 1;
+        next_char(scan);
+        scan->current = scan->mark + 1;
+        scan->ch = scan->source[scan->mark];
+        scan->mark = NO_MARK;
+    }
+    return scan->source[scan->current] == c;
 }
 
-TOKEN next_token(SCANNER *scan)
+/* white space, comments and escaped newlines */
+static void skip_blank(SCANNER *scan)
 {
     for (;;) {
-        while (is_white(scan->ch))
+        skip_space(scan);
+        if (scan->ch == '/' && peek_char(scan, '*')) {
+            next_char(scan);
+            skip_comment(scan);
+        } else if (scan->ch == '\\' && peek_char(scan, '\n')) {
+            bool bol = scan->bol;
+            next_char(scan);
             next_char(scan);
+            scan->bol = bol;
+        } else {
+            break;
+        }
+    }
+}
+
+/*
+ * move over the characters with any of the flags in cls.
+ * a lexeme started at source[mark] is kept in the buffer by refills.
+ */
+static void skip_class(SCANNER *scan, int cls)
+{
+    while (s_char_flags[(unsigned char) scan->ch] & cls) {
+        const char *p;
+        if (is_debug(DEBUG_SCANNER)) {
+            next_char(scan);
+            continue;
+        }
+        p = scan->source + scan->current;
+        while (s_char_flags[(unsigned char) *p] & cls)
+            p++;
+        skip_to(scan, p, 0);
+    }
+}
+
+/* identifiers and keywords are looked up in place, without a copy */
+static TOKEN scan_id(SCANNER *scan)
+{
+    const char *s;
+    size_t len;
+    TOKEN tk;
+
+    scan->mark = scan->current - 1;
+    skip_class(scan, CF_ALPHA | CF_DIGIT);
+    s = scan->source + scan->mark;
+    len = scan->current - 1 - scan->mark;
+    scan->mark = NO_MARK;
+    tk = lookup_keyword(s, len);
+    if (tk == TK_ID && scan->chunk != NULL)
+        scan->num = chunk_name(scan->chunk, s, len);
+    else if (tk == TK_ID)
+        scan->id = intern_n(scan->cc, s, len);
+    return tk;
+}
+
+static int digit_value(int ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return 16;
+}
+
+/* u, l, ll in either case and order; returns the end of the suffix */
+static const char *scan_int_suffix(const char *p, const char *end)
+{
+    bool u = false, l = false;
+
+    while (p < end) {
+        if ((*p == 'u' || *p == 'U') && !u) {
+            u = true;
+            p++;
+        } else if ((*p == 'l' || *p == 'L') && !l) {
+            l = true;
+            p += (p + 1 < end && p[1] == p[0]) ? 2 : 1;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+/*
+ * decimal, octal (0...) and hexadecimal (0x...) integer constants.
+ * the whole alphanumeric run is the lexeme, so "08" and "12ab" are
+ * reported instead of being split into two tokens.
+ */
+static TOKEN scan_num(SCANNER *scan)
+{
+    const char *p, *end;
+    unsigned long value = 0;
+    int base = 10;
+    bool overflow = false;
+
+    scan->mark = scan->current - 1;
+    skip_class(scan, CF_ALPHA | CF_DIGIT);
+    p = scan->source + scan->mark;
+    end = scan->source + scan->current - 1;
+    scan->mark = NO_MARK;
+
+    if (p[0] == '0' && end - p > 1 && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+        if (p == end || digit_value(*p) >= 16)
+            scan_error(scan, "invalid hexadecimal constant");
+    } else if (p[0] == '0') {
+        base = 8;
+    }
+    for (; p < end; p++) {
+        int d = digit_value(*p);
+        if (d >= base) {
+            if (base == 8 && d < 10)
+                scan_error(scan, "invalid digit '%c' in octal constant", *p);
+            break;
+        }
+        if (value > (UINT_MAX - d) / base)
+            overflow = true;
+        value = (value * base + d) & UINT_MAX;
+    }
+    if (scan_int_suffix(p, end) != end)
+        scan_error(scan, "invalid suffix \"%.*s\" on integer constant",
+                (int) (end - p), p);
+    if (overflow)
+        scan_warning(scan, "integer constant is too large");
+    scan->num = (int) value;
+    return TK_INT_LIT;
+}
+
+/*
+ * longest match through the operator DFA: it runs until it can go no
+ * further, then backs up to the last state that accepted a token, as
+ * '..' must not be taken for the start of '...'.  the characters are
+ * kept in the buffer as a lexeme, so a refill does not lose them.
+ * returns TK_EOF, at the first character, when no prefix is a token.
+ */
+static TOKEN scan_operator(SCANNER *scan)
+{
+    TOKEN tk = TK_EOF;
+    size_t since = 0;       /* characters read past the last accepted */
+    int state = 0;
+    int next;
+
+    scan->mark = scan->current - 1;
+    while ((next = s_op_next[state][s_op_class[(unsigned char) scan->ch]])
+                != 0) {
+        state = next;
+        next_char(scan);
+        since++;
+        if (s_op_token[state] != TK_EOF) {
+            tk = s_op_token[state];
+            since = 0;
+        }
+    }
+    if (since > 0) {
+        scan->current -= since;
+        scan->ch = scan->source[scan->current - 1];
+    }
+    scan->mark = NO_MARK;
+    return tk;
+}
+
+/*
+ * the next token of the source, without preprocessing.
+ * scan->first tells whether it began a line.
+ */
+TOKEN scan_token(SCANNER *scan)
+{
+    TOKEN tk;
+
+    if (scan->prescan != NULL && prescanned_token(scan, &tk)) {
+        scan->loc = offset_loc(scan, scan->start);
+        return tk;
+    }
+    for (;;) {
+        skip_blank(scan);
+        scan->first = scan->bol;
+        scan->bol = false;
+        scan->start = scan->offset + scan->current - 1;
+        scan->loc = offset_loc(scan, scan->start);
         if (scan->ch == '\0')
             return TK_EOF;
         if (is_alpha(scan->ch))
             return scan_id(scan);
-        if (isdigit(scan->ch))
+        if (is_digit(scan->ch))
             return scan_num(scan);
-        switch (scan->ch) {
-        case '#':
-            /* skip line */
-            while (scan->ch != EOF && scan->ch != '\n')
-                next_char(scan);
-            continue;
-        case '/':
-            if (next_char(scan) == '*') {
-                skip_comment(scan);
-                continue;
-            }
-            return TK_SLASH;
-        case ',':   next_char(scan);    return TK_COMMA;
-        case ';':   next_char(scan);    return TK_SEMI;
-        case '(':   next_char(scan);    return TK_LPAR;
-        case ')':   next_char(scan);    return TK_RPAR;
-        case '{':   next_char(scan);    return TK_BEGIN;
-        case '}':   next_char(scan);    return TK_END;
-        case '*':   next_char(scan);    return TK_STAR;
-        case '+':   next_char(scan);    return TK_PLUS;
-        case '-':   next_char(scan);    return TK_MINUS;
-        case '|':
-            if (next_char(scan) == '|') {
-                next_char(scan);
-                return TK_LOR;
-            }
-            break;
-        case '&':
-            if (next_char(scan) == '&') {
-                next_char(scan);
-                return TK_LAND;
-            }
-            return TK_AND;
-        case '=':
-            if (next_char(scan) == '=') {
-                next_char(scan);
-                return TK_EQ;
-            }
-            return TK_ASSIGN;
-        case '!':
-            if (next_char(scan) == '=') {
-                next_char(scan);
-                return TK_NEQ;
-            }
-            return TK_NOT;
-        case '<':
-            if (next_char(scan) == '=') {
-                next_char(scan);
-                return TK_LE;
-            }
-            return TK_LT;
-        case '>':
-            if (next_char(scan) == '=') {
-                next_char(scan);
-                return TK_GE;
-            }
-            return TK_GT;
-        default:
-            break;
-        }
-        error(&scan->pos,
+        tk = scan_operator(scan);
+        if (tk != TK_EOF)
+            return tk;
+        scan_error(scan,
             (isprint(scan->ch) ? "illegal character '%c'"
                               : "illegal character (code=%02d)"), scan->ch);
         next_char(scan);
     }
 }
 
-const char *token_to_string(TOKEN tk)
+/* go on from source[offset]; the source must be complete, not streamed */
+void seek_scanner(SCANNER *scan, size_t offset, bool bol)
+{
+    scan->current = offset;
+    scan->ch = ' ';
+    scan->bol = bol;
+}
+
+/* the location of the current character */
+SRCLOC scan_loc(const SCANNER *scan)
+{
+    return offset_loc(scan, scan->offset + (long long) scan->current - 1);
+}
+
+/* skip blanks on the current line; true at the end of the line or input */
+bool scan_eol(SCANNER *scan)
 {
-    switch (tk) {
-    case TK_EOF:        return "<EOF>";
-    case TK_ID:         return "<ID>";
-    case TK_INT_LIT:    return "<INT LIT>";
-    case TK_STATIC:     return "static";
-    case TK_EXTERN:     return "extern";
-    case TK_VOID:       return "void";
-    case TK_INT:        return "int";
-    case TK_IF:         return "if";
-    case TK_ELSE:       return "else";
-    case TK_WHILE:      return "while";
-    case TK_FOR:        return "for";
-    case TK_CONTINUE:   return "continue";
-    case TK_BREAK:      return "break";
-    case TK_RETURN:     return "return";
-    case TK_COMMA:      return ",";
-    case TK_SEMI:       return ";";
-    case TK_LPAR:       return "(";
-    case TK_RPAR:       return ")";
-    case TK_BEGIN:      return "{";
-    case TK_END:        return "}";
-    case TK_STAR:       return "*";
-    case TK_SLASH:      return "/";
-    case TK_PLUS:       return "+";
-    case TK_MINUS:      return "-";
-    case TK_ASSIGN:     return "=";
-    case TK_LOR:        return "||";
-    case TK_LAND:       return "&&";
-    case TK_EQ:         return "==";
-    case TK_NEQ:        return "!=";
-    case TK_LT:         return "<";
-    case TK_GT:         return ">";
-    case TK_LE:         return "<=";
-    case TK_GE:         return ">=";
-    case TK_AND:        return "&";
-    case TK_NOT:        return "!";
+    skip_blank(scan);
+    return scan->bol || scan->ch == '\0';
+}
+
+/* the rest of the line as text, for #error; to be freed by the caller */
+char *scan_rest_of_line(SCANNER *scan)
+{
+    size_t len;
+    char *text;
+
+    while (scan->ch == ' ' || scan->ch == '\t')
+        next_char(scan);
+    scan->mark = scan->current - 1;
+    skip_rest_of_line(scan);
+    len = scan->current - 1 - scan->mark;
+    while (len > 0 && is_white(scan->source[scan->mark + len - 1]))
+        len--;
+    text = (char*) alloc(len + 1);
+    memcpy(text, scan->source + scan->mark, len);
+    text[len] = '\0';
+    scan->mark = NO_MARK;
+    return text;
+}
+
+/*
+ * the "name" or <name> of an #include, taken as it is.
+ * returns NULL when the line holds no such name.
+ */
+char *scan_header_name(SCANNER *scan, bool *system)
+{
+    int close;
+    char *name;
+
+    if (scan_eol(scan))
+        return NULL;
+    if (scan->ch == '"')
+        close = '"';
+    else if (scan->ch == '<')
+        close = '>';
+    else
+        return NULL;
+    *system = (close == '>');
+    scan->mark = scan->current;
+    while (next_char(scan) != close) {
+        if (scan->ch == '\n' || scan->ch == '\0') {
+            scan->mark = NO_MARK;
+            return NULL;
+        }
     }
-    return "";
+    name = intern_n(scan->cc, scan->source + scan->mark,
+                    scan->current - 1 - scan->mark);
+    scan->mark = NO_MARK;
+    next_char(scan);
+    return name;
 }
 
-const char *scan_token_to_string(SCANNER *scan, TOKEN tk)
+/*
+ * skip the lines of a conditional group that is not taken, up to the
+ * next line beginning with '#'.  only comments and quotes are looked
+ * for, so the group need not consist of valid tokens.
+ */
+void skip_group(SCANNER *scan)
 {
-    static char buffer[MAX_BUFFER+1];
-    switch (tk) {
-    case TK_ID:
-        return scan->id;
-    case TK_INT_LIT:
-        sprintf(buffer, "%d", scan->num);
-        return buffer;
-    default:
-        break;
+    for (;;) {
+        skip_blank(scan);
+        if (scan->ch == '\0' || (scan->ch == '#' && scan->bol))
+            return;
+        scan->bol = false;
+        while (scan->ch != '\n' && scan->ch != '\0') {
+            int quote = scan->ch;
+            if (quote == '/' && peek_char(scan, '*')) {
+                next_char(scan);
+                skip_comment(scan);
+                continue;
+            }
+            next_char(scan);
+            if (quote != '"' && quote != '\'')
+                continue;
+            while (scan->ch != quote && scan->ch != '\n' && scan->ch != '\0') {
+                if (scan->ch == '\\')
+                    next_char(scan);
+                if (scan->ch != '\0')
+                    next_char(scan);
+            }
+            if (scan->ch == quote)
+                next_char(scan);
+        }
     }
-    return token_to_string(tk);
 }
 
+const char *token_to_string(TOKEN tk)
+{
+    static const char *const token_string[] = {
+#define TOKEN_SPECIAL(tk, s)    s,
+#define TOKEN_KEYWORD(tk, s)    s,
+#define TOKEN_OPERATOR(tk, s)   s,
+#include "token.def"
+#undef TOKEN_SPECIAL
+#undef TOKEN_KEYWORD
+#undef TOKEN_OPERATOR
+    };
+    if (tk < 0 || tk >= TK_COUNT)
+        return "";
+    return token_string[tk];
+}
@@ -0,0 +1,233 @@
+#include <pthread.h>
+#include "mcc.h"
+
+/*
+ * bulk skipping kernels for the scanner
+ * each kernel scans [p, end) and returns the first position it stops at,
+ * or end.  newlines passed over are added to *lines.
+ * end must be followed by the scanner's '\0' sentinel.
+ */
+
+typedef struct {
+    const char *(*white)(const char *p, const char *end, int *lines);
+    const char *(*comment)(const char *p, const char *end, int *lines);
+    const char *(*newline)(const char *p, const char *end);
+} SKIP_KERNEL;
+
+static int is_space(int ch)
+{
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+static const char *white_scalar(const char *p, const char *end, int *lines)
+{
+    for (; p < end && is_space(*p); p++)
+        if (*p == '\n')
+            ++*lines;
+    return p;
+}
+
+/* stops at "*" followed by "/", or at a "*" ending the block */
+static const char *comment_scalar(const char *p, const char *end, int *lines)
+{
+    for (; p < end; p++) {
+        if (*p == '*' && (p + 1 == end || p[1] == '/'))
+            return p;
+        if (*p == '\n')
+            ++*lines;
+    }
+    return p;
+}
+
+static const char *newline_scalar(const char *p, const char *end)
+{
+    while (p < end && *p != '\n')
+        p++;
+    return p;
+}
+
+static const SKIP_KERNEL s_scalar = {
+    white_scalar, comment_scalar, newline_scalar
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define LOW_BITS(n)     ((1u << (n)) - 1)
+
+__attribute__((target("sse2")))
+static unsigned white_mask_sse2(__m128i v)
+{
+    __m128i x = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(4)), x);
+    __m128i sp = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return _mm_movemask_epi8(_mm_or_si128(ctl, sp));
+}
+
+__attribute__((target("sse2")))
+static const char *white_sse2(const char *p, const char *end, int *lines)
+{
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        unsigned nl = _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        unsigned stop = ~white_mask_sse2(v) & 0xffff;
+        if (stop) {
+            int i = __builtin_ctz(stop);
+            *lines += __builtin_popcount(nl & LOW_BITS(i));
+            return p + i;
+        }
+        *lines += __builtin_popcount(nl);
+    }
+    return white_scalar(p, end, lines);
+}
+
+__attribute__((target("sse2")))
+static const char *comment_sse2(const char *p, const char *end, int *lines)
+{
+    for (; p + 17 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        __m128i w = _mm_loadu_si128((const __m128i*) (p + 1));
+        unsigned nl = _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        unsigned stop = _mm_movemask_epi8(_mm_and_si128(
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+                        _mm_cmpeq_epi8(w, _mm_set1_epi8('/'))));
+        if (stop) {
+            int i = __builtin_ctz(stop);
+            *lines += __builtin_popcount(nl & LOW_BITS(i));
+            return p + i;
+        }
+        *lines += __builtin_popcount(nl);
+    }
+    return comment_scalar(p, end, lines);
+}
+
+__attribute__((target("sse2")))
+static const char *newline_sse2(const char *p, const char *end)
+{
+    for (; p + 16 <= end; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        unsigned stop = _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        if (stop)
+            return p + __builtin_ctz(stop);
+    }
+    return newline_scalar(p, end);
+}
+
+static const SKIP_KERNEL s_sse2 = {
+    white_sse2, comment_sse2, newline_sse2
+};
+
+__attribute__((target("avx2")))
+static unsigned white_mask_avx2(__m256i v)
+{
+    __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(x,
+                                    _mm256_set1_epi8(4)), x);
+    __m256i sp = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    return _mm256_movemask_epi8(_mm256_or_si256(ctl, sp));
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char *white_avx2(const char *p, const char *end, int *lines)
+{
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        unsigned nl = _mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        unsigned stop = ~white_mask_avx2(v);
+        if (stop) {
+            int i = __builtin_ctz(stop);
+            *lines += __builtin_popcount(nl & LOW_BITS(i));
+            return p + i;
+        }
+        *lines += __builtin_popcount(nl);
+    }
+    return white_sse2(p, end, lines);
+}
+
+__attribute__((target("avx2,popcnt")))
+static const char *comment_avx2(const char *p, const char *end, int *lines)
+{
+    for (; p + 33 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        __m256i w = _mm256_loadu_si256((const __m256i*) (p + 1));
+        unsigned nl = _mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        unsigned stop = _mm256_movemask_epi8(_mm256_and_si256(
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+                        _mm256_cmpeq_epi8(w, _mm256_set1_epi8('/'))));
+        if (stop) {
+            int i = __builtin_ctz(stop);
+            *lines += __builtin_popcount(nl & LOW_BITS(i));
+            return p + i;
+        }
+        *lines += __builtin_popcount(nl);
+    }
+    return comment_sse2(p, end, lines);
+}
+
+__attribute__((target("avx2")))
+static const char *newline_avx2(const char *p, const char *end)
+{
+    for (; p + 32 <= end; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        unsigned stop = _mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        if (stop)
+            return p + __builtin_ctz(stop);
+    }
+    return newline_sse2(p, end);
+}
+
+static const SKIP_KERNEL s_avx2 = {
+    white_avx2, comment_avx2, newline_avx2
+};
+
+static const SKIP_KERNEL *select_kernel(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return &s_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return &s_sse2;
+    return &s_scalar;
+}
+#else
+static const SKIP_KERNEL *select_kernel(void)
+{
+    return &s_scalar;
+}
+#endif
+
+static const SKIP_KERNEL *s_kernel = NULL;
+static pthread_once_t s_kernel_once = PTHREAD_ONCE_INIT;
+
+static void init_kernel(void)
+{
+    s_kernel = select_kernel();
+}
+
+/* chosen once, whichever thread gets here first */
+static const SKIP_KERNEL *get_kernel(void)
+{
+    pthread_once(&s_kernel_once, init_kernel);
+    return s_kernel;
+}
+
+const char *skip_white(const char *p, const char *end, int *lines)
+{
+    return get_kernel()->white(p, end, lines);
+}
+
+const char *skip_to_comment_end(const char *p, const char *end, int *lines)
+{
+    return get_kernel()->comment(p, end, lines);
+}
+
+const char *skip_to_newline(const char *p, const char *end)
+{
+    return get_kernel()->newline(p, end);
+}
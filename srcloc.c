@@ -0,0 +1,273 @@
+#include <string.h>
+#include "mcc.h"
+
+/*
+ * source locations
+ * every source opened gets a range of locations, one for each byte and
+ * one for its end, and the location of a byte is the start of the range
+ * plus its offset.  the source of a location is found by a binary search
+ * over the ranges, and its line by another over the offsets of the
+ * newlines in the range.  the newlines are looked for only when a line
+ * is asked for, or before the text goes away.
+ *
+ * a streamed source, of a size not known, starts with a small range.
+ * when its input goes past the end, the next one is taken at the end of
+ * all locations given out, twice as large, up to STREAM_RANGE_MAX, and
+ * chained to it; the ranges are in the order of their locations all the
+ * same.  a location is 32 bits, so all the sources of a file compiled
+ * must be below 4 GiB together: past that, it is an error.
+ */
+
+#define STREAM_RANGE        (1u << 20)  /* the first of a streamed source */
+#define STREAM_RANGE_MAX    (1u << 30)
+
+typedef struct source {
+    const char *filename;
+    SRCLOC base;
+    unsigned range;
+    long long start;            /* input offset at base */
+    size_t next;                /* the range after it, 0: none */
+    size_t last;                /* of the chain, kept in its first range */
+    int first_line;             /* newlines before start */
+    long long line_start;       /* input offset of the line at start */
+    const char *text;           /* the part of the source in memory, */
+    long long text_offset;      /* from this input offset */
+    size_t text_size;
+    unsigned *newline;          /* offsets from start of the newlines */
+    size_t n_newline;
+    size_t newline_size;
+    long long indexed;          /* input offset the newlines are known to */
+} SOURCE;
+
+/* a range of r locations for the source, at the end of all given out */
+static SOURCE *new_range(COMPILER *cc, const char *filename, unsigned r)
+{
+    SOURCE *src;
+
+    if (r > 0xffffffffu - cc->next_loc)
+        error(cc, 0, "'%s': out of source locations, "
+                     "4 GiB of source at most", filename);
+    if (cc->n_source == cc->source_size) {
+        cc->source_size = cc->source_size ? cc->source_size * 2 : 64;
+        src = (SOURCE*) alloc(cc->source_size * sizeof (SOURCE));
+        memcpy(src, cc->source, cc->n_source * sizeof (SOURCE));
+        free(cc->source);
+        cc->source = src;
+    }
+    src = &cc->source[cc->n_source];
+    memset(src, 0, sizeof (SOURCE));
+    src->filename = filename;
+    src->base = cc->next_loc;
+    src->range = r;
+    src->last = cc->n_source++;
+    cc->next_loc += r;
+    return src;
+}
+
+/*
+ * a new source of the given size, -1 when it is not known.
+ * the locations of the source are base + [0, *range), and the
+ * locations past them are given by source_loc().
+ */
+SRCLOC add_source(COMPILER *cc, const char *filename, long long size,
+                  unsigned *range)
+{
+    SOURCE *src;
+
+    if (size > 0xfffffffdLL)
+        error(cc, 0, "'%s': out of source locations, "
+                     "4 GiB of source at most", filename);
+    src = new_range(cc, filename, size < 0 ? STREAM_RANGE
+                                           : (unsigned) size + 2);
+    *range = src->range;
+    return src->base;
+}
+
+/* the source loc is in, NULL for none */
+static SOURCE *find_source(COMPILER *cc, SRCLOC loc)
+{
+    SOURCE *source = cc->source;
+    size_t lo = 0, hi = cc->n_source;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (source[mid].base <= loc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0 || loc - source[lo - 1].base >= source[lo - 1].range)
+        return NULL;
+    return &source[lo - 1];
+}
+
+/* record the newlines of the text in memory before end */
+static void index_lines(SOURCE *src, long long end)
+{
+    const char *p, *q, *stop;
+
+    if (end > src->text_offset + (long long) src->text_size)
+        end = src->text_offset + src->text_size;
+    if (end > src->start + src->range)
+        end = src->start + src->range;
+    if (src->text == NULL || end <= src->indexed
+            || src->indexed < src->text_offset)
+        return;
+    p = src->text + (src->indexed - src->text_offset);
+    stop = src->text + (end - src->text_offset);
+    while ((q = skip_to_newline(p, stop)) < stop) {
+        if (src->n_newline == src->newline_size) {
+            unsigned *nl;
+            src->newline_size = src->newline_size ? src->newline_size * 2
+                                                  : 1024;
+            nl = (unsigned*) alloc(src->newline_size * sizeof (unsigned));
+            memcpy(nl, src->newline, src->n_newline * sizeof (unsigned));
+            free(src->newline);
+            src->newline = nl;
+        }
+        src->newline[src->n_newline++] =
+                src->text_offset + (q - src->text) - src->start;
+        p = q + 1;
+    }
+    src->indexed = end;
+}
+
+/*
+ * the location of input offset of the source at base, past its first
+ * range.  the range going on from the last is added when the input gets
+ * there, with the text before it still in memory to count its lines.
+ */
+SRCLOC source_loc(COMPILER *cc, SRCLOC base, long long offset)
+{
+    size_t first = find_source(cc, base) - cc->source;
+    SOURCE *src = &cc->source[cc->source[first].last];
+
+    if (offset < src->start) {         /* back in an earlier one */
+        src = &cc->source[first];
+        while (offset >= src->start + src->range)
+            src = &cc->source[src->next];
+    }
+    while (offset >= src->start + src->range) {
+        unsigned r = src->range < STREAM_RANGE_MAX ? src->range * 2
+                                                   : STREAM_RANGE_MAX;
+        size_t prev = src - cc->source;
+        SOURCE *next;
+
+        if (r > 0xffffffffu - cc->next_loc && cc->next_loc < 0xffffffffu)
+            r = 0xffffffffu - cc->next_loc;     /* the last there are */
+        index_lines(src, src->start + src->range);
+        next = new_range(cc, src->filename, r);    /* may move them */
+        src = &cc->source[prev];
+        next->start = src->start + src->range;
+        next->indexed = next->start;
+        next->first_line = src->first_line + src->n_newline;
+        next->line_start = src->n_newline > 0
+                ? src->start + src->newline[src->n_newline - 1] + 1
+                : src->line_start;
+        next->text = src->text;
+        next->text_offset = src->text_offset;
+        next->text_size = src->text_size;
+        src->next = cc->n_source - 1;
+        cc->source[first].last = src->next;
+        src = next;
+    }
+    return src->base + (unsigned) (offset - src->start);
+}
+
+/*
+ * the text of the source from input offset on, NULL when it is gone.
+ * the ranges for all of it are taken now, while its lines can be counted.
+ */
+void set_source_text(COMPILER *cc, SRCLOC base, const char *text,
+                     long long offset, size_t size)
+{
+    SOURCE *src = find_source(cc, base);
+    size_t last = src->last;
+
+    for (;;) {
+        src->text = text;
+        src->text_offset = offset;
+        src->text_size = size;
+        if (src->next == 0)
+            break;
+        src = &cc->source[src->next];
+    }
+    src = &cc->source[last];
+    if (offset + (long long) size >= src->start + src->range)
+        source_loc(cc, base, offset + size);
+}
+
+/* the text before input offset end is about to go */
+void drop_source_text(COMPILER *cc, SRCLOC base, long long end)
+{
+    SOURCE *src = find_source(cc, base);
+
+    for (;;) {
+        index_lines(src, end);
+        if (src->next == 0)
+            break;
+        src = &cc->source[src->next];
+    }
+}
+
+void free_sources(COMPILER *cc)
+{
+    size_t i;
+
+    for (i = 0; i < cc->n_source; i++)
+        free(cc->source[i].newline);
+    free(cc->source);
+    cc->source = NULL;
+    cc->n_source = cc->source_size = 0;
+}
+
+/* the newlines of all text in memory; decode_loc() then only reads */
+void index_sources(COMPILER *cc)
+{
+    size_t i;
+
+    for (i = 0; i < cc->n_source; i++)
+        index_lines(&cc->source[i],
+                    cc->source[i].start + cc->source[i].range);
+}
+
+const char *loc_filename(COMPILER *cc, SRCLOC loc)
+{
+    const SOURCE *src = find_source(cc, loc);
+    return src != NULL ? src->filename : "";
+}
+
+POS decode_loc(COMPILER *cc, SRCLOC loc)
+{
+    SOURCE *src = find_source(cc, loc);
+    unsigned offset;
+    size_t lo = 0, hi;
+    POS pos;
+
+    pos.filename = "";
+    pos.line = 0;
+    pos.column = 0;
+    if (src == NULL)
+        return pos;
+    offset = loc - src->base;
+    if (src->start + offset >= src->indexed)
+        index_lines(src, src->start + src->range);
+    hi = src->n_newline;
+    while (lo < hi) {           /* newlines before offset */
+        size_t mid = lo + (hi - lo) / 2;
+        if (src->newline[mid] < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    pos.filename = src->filename;
+    pos.line = src->first_line + lo + 1;
+    pos.column = (lo > 0 ? offset - (src->newline[lo - 1] + 1)
+                         : src->start + offset - src->line_start) + 1;
+    return pos;
+}
+
+int loc_line(COMPILER *cc, SRCLOC loc)
+{
+    return decode_loc(cc, loc).line;
+}
@@ -2,54 +2,134 @@
 #include <string.h>
 #include "mcc.h"
 
-TYPE g_type_int = { T_INT, NULL, NULL };
-TYPE g_type_null = { T_NULL, NULL, NULL };
+/* hash_type() of a type with nothing below it */
+#define HASH_LEAF(kind) ((2166136261u ^ (kind)) * 16777619u)
 
-static SYMTAB *global_table = NULL;
-static SYMTAB *current_symtab = NULL;
-static SYMBOL *current_function = NULL;
+TYPE g_type_int = { T_INT, NULL, NULL, HASH_LEAF(T_INT) };
+TYPE g_type_null = { T_NULL, NULL, NULL, HASH_LEAF(T_NULL) };
 
-TYPE *new_type(TYPE_KIND kind, TYPE *ref_typ, PARAM *param)
+/*
+ * types are hash-consed: new_type returns the one type of the given
+ * kind, referred type and parameter types, so equal types are the same
+ * pointer.  they live in the arena of the file, as long as the table.
+ * the parameters of a type have no names; a declaration keeps its own
+ * list for that.
+ */
+#define TYPE_INIT_SIZE  256         /* must be power of 2 */
+
+static unsigned hash_type(TYPE_KIND kind, const TYPE *ref_typ,
+                          const PARAM *param)
 {
-    TYPE *typ = (TYPE*) alloc(sizeof (TYPE));
-    typ->kind = kind;
-    typ->type = ref_typ;
-    typ->param = param;
-    return typ;
+    unsigned h = 2166136261u ^ kind;
+
+    h = (h ^ (ref_typ ? ref_typ->hash : 0)) * 16777619u;
+    for (; param != NULL; param = param->next)
+        h = (h ^ (param->type ? param->type->hash : 1)) * 16777619u;
+    return h;
 }
 
-TYPE *dup_type(TYPE *tp)
+static bool same_type(const TYPE *typ, TYPE_KIND kind, const TYPE *ref_typ,
+                      const PARAM *param)
 {
-    return new_type(tp->kind, tp->type, tp->param);
+    const PARAM *p;
+
+    if (typ->kind != kind || typ->type != ref_typ)
+        return false;
+    for (p = typ->param; p != NULL && param != NULL; p = p->next) {
+        if (p->type != param->type)
+            return false;
+        param = param->next;
+    }
+    return p == NULL && param == NULL;
 }
 
+static void insert_type(COMPILER *cc, TYPE *typ)
+{
+    size_t i = typ->hash & (cc->type_size - 1);
+
+    while (cc->type_table[i] != NULL)
+        i = (i + 1) & (cc->type_size - 1);
+    cc->type_table[i] = typ;
+    cc->type_count++;
+}
+
+static void grow_type_table(COMPILER *cc)
+{
+    TYPE **old = cc->type_table;
+    size_t old_size = cc->type_size;
+    size_t i;
+
+    cc->type_size = old_size ? old_size * 2 : TYPE_INIT_SIZE;
+    cc->type_table = (TYPE**) alloc(cc->type_size * sizeof (TYPE*));
+    memset(cc->type_table, 0, cc->type_size * sizeof (TYPE*));
+    cc->type_count = 0;
+    for (i = 0; i < old_size; i++) {
+        if (old[i] != NULL)
+            insert_type(cc, old[i]);
+    }
+    free(old);
+}
+
+static void init_types(COMPILER *cc)
+{
+    grow_type_table(cc);
+    insert_type(cc, &g_type_int);
+    insert_type(cc, &g_type_null);
+}
+
+static void term_types(COMPILER *cc)
+{
+    free(cc->type_table);
+    cc->type_table = NULL;
+    cc->type_size = cc->type_count = 0;
+}
+
+TYPE *new_type(COMPILER *cc, TYPE_KIND kind, TYPE *ref_typ, PARAM *param)
+{
+    unsigned hash;
+    TYPE *typ;
+    PARAM *p, **pp;
+    size_t i;
+
+    if (cc->parent != NULL) {   /* a worker: the table is not its own */
+        pthread_mutex_lock(&cc->parent->type_lock);
+        typ = new_type(cc->parent, kind, ref_typ, param);
+        pthread_mutex_unlock(&cc->parent->type_lock);
+        return typ;
+    }
+    hash = hash_type(kind, ref_typ, param);
+    if ((cc->type_count + 1) * 2 > cc->type_size)
+        grow_type_table(cc);
+    for (i = hash & (cc->type_size - 1); cc->type_table[i] != NULL;
+            i = (i + 1) & (cc->type_size - 1)) {
+        typ = cc->type_table[i];
+        if (typ->hash == hash && same_type(typ, kind, ref_typ, param))
+            return typ;
+    }
+    typ = (TYPE*) arena_alloc(cc->file_arena, sizeof (TYPE));
+    typ->kind = kind;
+    typ->type = ref_typ;
+    typ->param = NULL;
+    typ->hash = hash;
+    for (pp = &typ->param; param != NULL; param = param->next) {
+        p = (PARAM*) arena_alloc(cc->file_arena, sizeof (PARAM));
+        p->next = NULL;
+        p->id = NULL;
+        p->type = param->type;
+        *pp = p;
+        pp = &p->next;
+    }
+    cc->type_table[i] = typ;
+    cc->type_count++;
+    return typ;
+}
+
+/* int and null are taken for each other */
 bool equal_type(const TYPE *tl, const TYPE *tr)
 {
-    if (tl == NULL && tr == NULL)
-        return true;
-    if (tl == NULL || tr == NULL)
-        return false;
-    if (tl->kind == T_INT && tr->kind == T_NULL)
-        return true;
-    if (tl->kind == T_NULL && tr->kind == T_INT)
+    if (tl == tr)
         return true;
-    if (tl->kind != tr->kind)
-        return false;
-    if (!equal_type(tl->type, tr->type))
-        return false;
-    {
-        PARAM *pl = tl->param;
-        PARAM *pr = tr->param;
-        while (pl != NULL && pr != NULL) {
-            if (!equal_type(pl->type, pr->type))
-                return false;
-            pl = pl->next;
-            pr = pr->next;
-        }
-        if (pl != NULL || pr != NULL)
-            return false;
-    }
-    return true;
+    return type_is_int(tl) && type_is_int(tr);
 }
 
 bool type_is_void(const TYPE *typ)
@@ -175,9 +255,9 @@ bool type_warn_assign(const TYPE *lhs, const TYPE *rhs)
     return false;
 }
 
-PARAM *link_param(PARAM *top, TYPE *typ, char *id)
+PARAM *link_param(COMPILER *cc, PARAM *top, TYPE *typ, char *id)
 {
-    PARAM *param = (PARAM*) alloc(sizeof (PARAM));
+    PARAM *param = (PARAM*) new_object(cc, sizeof (PARAM));
     PARAM *p;
     param->next = NULL;
     param->id = id;
@@ -234,15 +314,15 @@ void print_type(const TYPE *typ)
 }
 
 SYMBOL *
-new_symbol(SYMBOL_KIND kind, STORAGE_CLASS sc, const char *id,
+new_symbol(COMPILER *cc, SYMBOL_KIND kind, STORAGE_CLASS sc, const char *id,
             TYPE *type, int var_num)
 {
     SYMBOL *p;
 
-    assert(current_symtab);
-    p = (SYMBOL*) alloc(sizeof (SYMBOL));
-    p->next = current_symtab->sym;
-    current_symtab->sym = p;
+    assert(cc->current_symtab);
+    p = (SYMBOL*) new_object(cc, sizeof (SYMBOL));
+    p->next = cc->current_symtab->sym;
+    cc->current_symtab->sym = p;
     p->sclass = sc;
     p->kind = kind;
     p->id = id;
@@ -250,31 +330,33 @@ new_symbol(SYMBOL_KIND kind, STORAGE_CLASS sc, const char *id,
     p->has_body = false;
     p->body_node = NULL;
     p->tab = NULL;
+    p->arena = NULL;
     p->var_num = var_num;
+    p->body_index = 0;
     if (var_num > 0) {
-        assert(current_function);
-        current_function->var_num = var_num;
+        assert(cc->current_function);
+        cc->current_function->var_num = var_num;
     }
 
     return p;
 }
 
-SYMBOL *lookup_symbol_local(const char *id)
+SYMBOL *lookup_symbol_local(COMPILER *cc, const char *id)
 {
     SYMBOL *sym;
-    for (sym = current_symtab->sym; sym != NULL; sym = sym->next) {
+    for (sym = cc->current_symtab->sym; sym != NULL; sym = sym->next) {
         if (sym->id == id)
             return sym;
     }
     return NULL;
 }
 
-SYMBOL *lookup_symbol(const char *id)
+SYMBOL *lookup_symbol(COMPILER *cc, const char *id)
 {
     SYMTAB *tab;
     SYMBOL *sym;
 
-    for (tab = current_symtab; tab != NULL; tab = tab->up) {
+    for (tab = cc->current_symtab; tab != NULL; tab = tab->up) {
         for (sym = tab->sym; sym != NULL; sym = sym->next) {
             if (sym->id == id)
                 return sym;
@@ -284,53 +366,216 @@ SYMBOL *lookup_symbol(const char *id)
 }
 
 
-SYMTAB *new_symtab(SYMTAB *up)
+SYMTAB *new_symtab(COMPILER *cc, SYMTAB *up)
 {
-    SYMTAB *tab = (SYMTAB*) alloc(sizeof (SYMTAB));
+    SYMTAB *tab = (SYMTAB*) new_object(cc, sizeof (SYMTAB));
     tab->sym = NULL;
     tab->up = up;
     return tab;
 }
 
-SYMTAB *enter_scope(void)
+SYMTAB *enter_scope(COMPILER *cc)
 {
-    SYMTAB *tab = new_symtab(current_symtab);
-    return current_symtab = tab;
+    SYMTAB *tab = new_symtab(cc, cc->current_symtab);
+    return cc->current_symtab = tab;
 }
 
-void leave_scope(void)
+void leave_scope(COMPILER *cc)
 {
-    assert(current_symtab->up);
-    current_symtab = current_symtab->up;
+    assert(cc->current_symtab->up);
+    cc->current_symtab = cc->current_symtab->up;
 }
 
-SYMTAB *enter_function(SYMBOL *sym)
+/*
+ * the body of a function is kept in an arena of its own, freed after
+ * the function is compiled.  an arena left by a body that could not be
+ * parsed is freed when the function is defined again.
+ */
+SYMTAB *enter_function(COMPILER *cc, SYMBOL *sym)
 {
-    current_function = sym;
-    return enter_scope();
+    free_arena(sym->arena);
+    sym->arena = new_arena(cc);
+    use_arena(cc, sym->arena);
+    cc->current_function = sym;
+    return enter_scope(cc);
 }
 
-void leave_function(void)
+void leave_function(COMPILER *cc)
 {
-    leave_scope();
-    current_function = NULL;
+    leave_scope(cc);
+    cc->current_function = NULL;
+    use_arena(cc, cc->file_arena);
 }
 
-int get_func_var_num(void)
+static void free_function(SYMBOL *sym)
 {
-    assert(current_function);
-    return current_function->var_num;
+    free_arena(sym->arena);
+    sym->arena = NULL;
+    sym->tab = NULL;
+    sym->body_node = NULL;
 }
 
-bool init_symtab(void)
+/* the scope to go back to after an error */
+SYMTAB *get_scope(COMPILER *cc)
 {
-    global_table = new_symtab(NULL);
-    current_symtab = global_table;
+    return cc->current_symtab;
+}
+
+void set_scope(COMPILER *cc, SYMTAB *tab)
+{
+    cc->current_symtab = tab;
+    if (tab == cc->global_table) {
+        cc->current_function = NULL;
+        use_arena(cc, cc->file_arena);
+    }
+}
+
+int get_func_var_num(COMPILER *cc)
+{
+    assert(cc->current_function);
+    return cc->current_function->var_num;
+}
+
+/* one symbol table for each file */
+bool init_symtab(COMPILER *cc)
+{
+    cc->file_arena = new_arena(cc);
+    use_arena(cc, cc->file_arena);
+    init_types(cc);
+    cc->global_table = new_symtab(cc, NULL);
+    cc->current_symtab = cc->global_table;
+    cc->current_function = NULL;
     return true;
 }
 
-void term_symtab(void)
+void term_symtab(COMPILER *cc)
 {
+    SYMBOL *sym;
+
+    if (cc->global_table == NULL)
+        return;
+    for (sym = cc->global_table->sym; sym != NULL; sym = sym->next)
+        free_arena(sym->arena);
+    term_types(cc);
+    free_arena(cc->file_arena);
+    cc->file_arena = NULL;
+    cc->global_table = cc->current_symtab = NULL;
+}
+
+/*
+ * precompiled prefix
+ * types are written bottom up, so a type refers only to types before
+ * it.  type numbers start at 1; 0 is no type.
+ */
+typedef struct {
+    unsigned kind;
+    unsigned type;
+    unsigned param;         /* first in PCH_PARAMS */
+    unsigned n_param;
+} PCH_TYPE;
+
+typedef struct {
+    unsigned id;
+    unsigned type;
+} PCH_PARAM;
+
+typedef struct {
+    unsigned sclass;
+    unsigned kind;
+    unsigned id;
+    unsigned type;
+    int var_num;
+} PCH_SYMBOL;
+
+static unsigned save_type(PCH *pch, const TYPE *typ)
+{
+    PCH_TYPE t;
+    PCH_PARAM *params;
+    const PARAM *p;
+    unsigned i;
+
+    if (typ == NULL)
+        return 0;
+    t.kind = typ->kind;
+    t.type = save_type(pch, typ->type);
+    t.n_param = 0;
+    for (p = typ->param; p != NULL; p = p->next)
+        t.n_param++;
+    params = (PCH_PARAM*) alloc((t.n_param + 1) * sizeof (PCH_PARAM));
+    for (p = typ->param, i = 0; p != NULL; p = p->next, i++) {
+        params[i].id = pch_string(pch, p->id);
+        params[i].type = save_type(pch, p->type);
+    }
+    t.param = pch_count(pch, PCH_PARAMS, sizeof (PCH_PARAM));
+    pch_put(pch, PCH_PARAMS, params, t.n_param * sizeof (PCH_PARAM));
+    free(params);
+    pch_put(pch, PCH_TYPES, &t, sizeof t);
+    return pch_count(pch, PCH_TYPES, sizeof t);
+}
+
+/* false if a function is defined: bodies are not kept in the image */
+bool save_symtab(COMPILER *cc, PCH *pch)
+{
+    SYMBOL *sym, **list;
+    int n = 0;
+
+    for (sym = cc->global_table->sym; sym != NULL; sym = sym->next) {
+        if (sym->has_body)
+            return false;
+        n++;
+    }
+    list = (SYMBOL**) alloc((n + 1) * sizeof (SYMBOL*));
+    n = 0;
+    for (sym = cc->global_table->sym; sym != NULL; sym = sym->next)
+        list[n++] = sym;
+    while (--n >= 0) {      /* oldest first, as they will be entered */
+        PCH_SYMBOL s;
+        sym = list[n];
+        s.sclass = sym->sclass;
+        s.kind = sym->kind;
+        s.id = pch_string(pch, sym->id);
+        s.type = save_type(pch, sym->type);
+        s.var_num = sym->var_num;
+        pch_put(pch, PCH_SYMBOLS, &s, sizeof s);
+    }
+    free(list);
+    return true;
+}
+
+void load_symtab(COMPILER *cc, PCH *pch)
+{
+    const PCH_TYPE *types;
+    const PCH_PARAM *params;
+    const PCH_SYMBOL *syms;
+    unsigned n_types, n_params, n_syms, i, j;
+    TYPE **map;
+
+    types = (const PCH_TYPE*) pch_section(pch, PCH_TYPES,
+                                          sizeof (PCH_TYPE), &n_types);
+    params = (const PCH_PARAM*) pch_section(pch, PCH_PARAMS,
+                                            sizeof (PCH_PARAM), &n_params);
+    syms = (const PCH_SYMBOL*) pch_section(pch, PCH_SYMBOLS,
+                                           sizeof (PCH_SYMBOL), &n_syms);
+    map = (TYPE**) alloc((n_types + 1) * sizeof (TYPE*));
+    map[0] = NULL;
+    for (i = 0; i < n_types; i++) {
+        const PCH_TYPE *t = &types[i];
+        PARAM *plist = NULL;
+        for (j = t->param; j < t->param + t->n_param && j < n_params; j++)
+            plist = link_param(cc, plist,
+                        params[j].type <= i ? map[params[j].type] : NULL,
+                        pch_id(pch, params[j].id));
+        map[i+1] = new_type(cc, (TYPE_KIND) t->kind,
+                            t->type <= i ? map[t->type] : NULL, plist);
+    }
+    for (i = 0; i < n_syms; i++) {
+        SYMBOL *sym = new_symbol(cc, (SYMBOL_KIND) syms[i].kind,
+                        (STORAGE_CLASS) syms[i].sclass,
+                        pch_id(pch, syms[i].id),
+                        syms[i].type <= n_types ? map[syms[i].type] : NULL, 0);
+        sym->var_num = syms[i].var_num;
+    }
+    free(map);
 }
 
 const char *get_storage_class_string(STORAGE_CLASS sc)
@@ -352,62 +597,69 @@ static const char *get_kind_string(SYMBOL_KIND kind)
     return NULL;
 }
 
-void fprint_symbol(FILE *fp, int indent, const SYMBOL *sym)
+void fprint_symbol(COMPILER *cc, FILE *fp, int indent, const SYMBOL *sym)
 {
     fprintf(fp, "%*sSYM %s %s(%d) %s:", indent, "",
         sym->id, get_kind_string(sym->kind),
         sym->var_num, get_storage_class_string(sym->sclass));
     fprint_type(fp, sym->type);
     fprintf(fp, "\n");
-    if (sym->kind == SK_FUNC && sym->has_body) {
+    if (sym->kind == SK_FUNC && sym->body_node != NULL) {
         indent += 2;
         fprintf(fp, "%*slocal tab\n", indent, "");
-        fprint_symtab_1(fp, indent, sym->tab);
-        fprint_node(fp, indent, sym->body_node);
+        fprint_symtab_1(cc, fp, indent, sym->tab);
+        fprint_node(cc, fp, indent, sym->body_node);
     }
 }
 
-void fprint_symtab_1(FILE *fp, int indent, const SYMTAB *tab)
+void fprint_symtab_1(COMPILER *cc, FILE *fp, int indent, const SYMTAB *tab)
 {
     const SYMBOL *sym;
     if (tab == NULL)
         return;
     for (sym = tab->sym; sym != NULL; sym = sym->next) {
-        fprint_symbol(fp, indent, sym);
+        fprint_symbol(cc, fp, indent, sym);
     }
 }
 
-void print_symtab(const SYMTAB *tab)
+void print_symtab(COMPILER *cc, const SYMTAB *tab)
 {
     for (; tab != NULL; tab = tab->up) {
-        fprint_symtab_1(stdout, 0, tab);
+        fprint_symtab_1(cc, stdout, 0, tab);
     }
 }
 
-void print_global_symtab(void)
+void fprint_global_symtab(COMPILER *cc, FILE *fp)
 {
-    print_symtab(global_table);
+    fprint_symtab_1(cc, fp, 0, cc->global_table);
+}
+
+void print_global_symtab(COMPILER *cc)
+{
+    print_symtab(cc, cc->global_table);
 }
 
 
-bool compile_symtab(FILE *fp, const SYMTAB *tab)
+/* the body of each function is freed once it is compiled */
+bool compile_symtab(COMPILER *cc, FILE *fp, SYMTAB *tab)
 {
-    const SYMBOL *sym;
+    SYMBOL *sym;
     if (tab == NULL)
         return true;
     for (sym = tab->sym; sym != NULL; sym = sym->next) {
-        if (sym->kind == SK_VAR && !compile_symbol(fp, sym))
+        if (sym->kind == SK_VAR && !compile_symbol(cc, fp, sym))
             return false;
     }
     for (sym = tab->sym; sym != NULL; sym = sym->next) {
-        if (sym->kind == SK_FUNC && !compile_symbol(fp, sym))
+        if (sym->kind == SK_FUNC && !compile_symbol(cc, fp, sym))
             return false;
+        free_function(sym);
     }
     return true;
 }
 
-bool compile_all(FILE *fp)
+bool compile_all(COMPILER *cc, FILE *fp)
 {
     gen_header(fp);
-    return compile_symtab(fp, global_table);
+    return compile_symtab(cc, fp, cc->global_table);
 }
@@ -1,55 +1,79 @@
+#include <string.h>
 #include "mcc.h"
 
+static bool s_token_stream = false;
+static bool s_lazy_bodies = false;
+static int s_error_limit = -1;         /* -1: the default */
+
 int compile_file(const char *filename)
 {
+    COMPILER *cc = new_compiler();
     PARSER *pars;
+    bool ok;
     int result = 0;
 
-    init_symtab();
-    pars = open_parser(filename);
+    if (s_error_limit >= 0)
+        set_error_limit(cc, s_error_limit);
+    init_symtab(cc);
+    pars = open_parser(cc, filename);
     if (pars == NULL) {
         printf("can't open '%s'\n", filename);
+        free_compiler(cc);
         return 1;
     }
-    if (setjmp(g_error_jmp_buf) != 0) {
+    if (setjmp(cc->error_jmp_buf) != 0) {
         close_parser(pars);
         result++;
     } else {
-        parse(pars);
+        if (s_token_stream)
+            prelex(pars);
+        if (s_lazy_bodies)
+            skip_bodies(pars);
+        ok = parse(pars);
+        if (s_lazy_bodies)
+            ok = parse_bodies(pars);
+        if (!ok)
+            result++;
         close_parser(pars);
     }
-    print_global_symtab();
-    term_symtab();
+    flush_diagnostics(cc);
+    print_global_symtab(cc);
+    free_compiler(cc);
     return result;
 }
 
 static void show_help(void)
 {
     printf("test_parser\n");
-    printf("usage: test_parser [-h][-dX] filename\n");
+    printf("usage: test_parser [-h][-dX][-fX] filename\n");
     printf("option\n");
     printf("  -h       help\n");
     printf("  -dl  set scanner debug\n");
     printf("  -dp  set parser debug\n");
     printf("  -ds  set symbol debug\n");
+    printf("  -ftoken-stream  lex the whole file before parsing\n");
+    printf("  -flazy-bodies   parse function bodies after all declarations\n");
+    printf("  -flex-threads=n lex the token stream on n threads\n");
+    printf("  -fbody-threads=n parse function bodies on n threads\n");
+    printf("  -ferror-limit=n give up a file after n errors, 0: no limit\n");
 }
 
 static int parse_command_line(int argc, char *argv[])
 {
     struct {
         char option;
-        char *debug;
+        DEBUG_CHANNEL debug;
     } options[] = {
-        { 'l', "scanner" },
-        { 'p', "parser" },
-        { 's', "symbol" },
+        { 'l', DEBUG_SCANNER },
+        { 'p', DEBUG_PARSER },
+        { 's', DEBUG_SYMBOL },
     };
     const int N_OPTIONS = sizeof (options) / sizeof (options[1]);
     int i, j, n = 0;
     int n_file = 0;
 
     for (i = 1; i < argc; i++) {
-        if (argv[i][0] == '-') {
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
             switch (argv[i][1]) {
             case 'd':
                 for (j = 0; j < N_OPTIONS; j++) {
@@ -60,6 +84,30 @@ static int parse_command_line(int argc, char *argv[])
                 }
                 show_help();
                 return 1;
+            case 'f':
+                if (strcmp(argv[i] + 2, "token-stream") == 0) {
+                    s_token_stream = true;
+                    goto next;
+                }
+                if (strcmp(argv[i] + 2, "lazy-bodies") == 0) {
+                    s_lazy_bodies = true;
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "lex-threads=", 12) == 0) {
+                    set_lex_threads(atoi(argv[i] + 14));
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "body-threads=", 13) == 0) {
+                    set_body_threads(atoi(argv[i] + 15));
+                    s_lazy_bodies = true;
+                    goto next;
+                }
+                if (strncmp(argv[i] + 2, "error-limit=", 12) == 0) {
+                    s_error_limit = atoi(argv[i] + 14);
+                    goto next;
+                }
+                show_help();
+                return 1;
             default:
                 goto done;
             }
@@ -79,5 +127,5 @@ done:
 
 int main(int argc, char *argv[])
 {
-    return parse_command_line(argc, argv);
+    return parse_command_line(argc, argv) != 0;
 }
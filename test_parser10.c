@@ -0,0 +1,17 @@
+int f(int a)
+{
+    a = a +;
+    return a;
+}
+
+int g(int a)
+{
+    return -;
+}
+
+int h(int a)
+{
+    a = * ;
+    a = a -;
+    return a;
+}
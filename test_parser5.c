@@ -0,0 +1,2 @@
+int g(int (int), int (*)(int));
+int h(void (*f)());
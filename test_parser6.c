@@ -0,0 +1,13 @@
+void f()
+{
+    int a;
+
+    a = 0x7fffffff;
+    a = 0XffffFFFF;
+    a = 017;
+    a = 0;
+    a = 10u;
+    a = 10L;
+    a = 10LLu;
+    a = 4294967296;
+}
@@ -0,0 +1,29 @@
+#include "test_parser7.h"
+#include "test_parser7.h"
+
+#define N       10
+#define x       x
+#define CALL(...)   f(__VA_ARGS__)
+
+#if defined(N) && N > 5 && !defined(M)
+int taken;
+#elif 1
+int not_taken1;
+#else
+int not_taken2;
+#endif
+
+#ifdef M
+'not tokens' /* nor
+#endif */
+#else
+int taken_else;
+#endif
+
+int f(int a, int b)
+{
+    int x;
+    x = ADD(N, CAT(1, 2)) * \
+        2;
+    return CALL(a, b);
+}
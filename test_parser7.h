@@ -0,0 +1,8 @@
+#ifndef TEST_PARSER7_H
+#define TEST_PARSER7_H
+
+#define ADD(a, b)   ((a) + (b))
+#define CAT(a, b)   a ## b
+int shared;
+
+#endif
@@ -0,0 +1,23 @@
+int f(int a)
+{
+    int x;
+    int x;
+    x = a +;
+    if (a) y = 1; else x = 2;
+    while (x) {
+        x = x - 1
+    }
+    return x;
+}
+
+int g(int a b)
+{
+    return a;
+}
+
+int h(void)
+{
+    int z;
+    z = f(1);
+    return z;
+}
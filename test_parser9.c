@@ -0,0 +1,28 @@
+int f(int);
+
+int foo(int x, int *p)
+{
+    int a;
+
+    a = 1 + 2 * 3;
+    a = (7 - 10) / 2;
+    a = -(2 + 3) * -4;
+    a = 1 < 2;
+    a = 2 <= 1 || 0;
+    a = !0 && !5;
+    a = 2147483647 + 1;
+    a = 1 / 0;
+    a = x / (1 - 1);
+    a = 0 && f(x);
+    a = 1 && f(x);
+    a = 1 || f(x);
+    a = x * 1 + f(x) * 1;
+    a = f(x) + 0 - 0;
+    a = 0 + f(x) / 1;
+    a = !!x;
+    a = !!(x < a);
+    a = !!f(x) - 1 * 1;
+    p = 3 - 3;
+    p = x - x;
+    return --x;
+}
@@ -1,24 +1,27 @@
 #include "mcc.h"
 
-int scan_file(const char *filename)
+int scan_file(COMPILER *cc, const char *filename)
 {
     SCANNER *scan;
     TOKEN tk;
 
-    scan = open_scanner(filename);
+    scan = open_scanner(cc, filename);
     if (scan == NULL) {
         printf("can't open '%s'\n", filename);
         return 1;
     }
-    if (setjmp(g_error_jmp_buf) != 0) {
+    if (setjmp(cc->error_jmp_buf) != 0) {
         close_scanner(scan);
+        flush_diagnostics(cc);
         return 1;
     }
     while ((tk = next_token(scan)) != TK_EOF) {
-        printf("%s(%d): %s\n", scan->pos.filename, scan->pos.line,
-                token_to_string(tk));
+        POS pos = decode_loc(cc, scan->loc);
+        flush_diagnostics(cc);  /* warnings in order with the tokens */
+        printf("%s(%d): %s\n", pos.filename, pos.line, token_to_string(tk));
     }
     close_scanner(scan);
+    flush_diagnostics(cc);
     return 0;
 }
 
@@ -31,22 +34,22 @@ static void show_help(void)
     printf("  -dl  set scanner debug\n");
 }
 
-static int parse_command_line(int argc, char *argv[])
+static int parse_command_line(COMPILER *cc, int argc, char *argv[])
 {
     struct {
         char option;
-        char *debug;
+        DEBUG_CHANNEL debug;
     } options[] = {
-        { 'l', "scanner" },
-        { 'p', "parser" },
-        { 's', "symbol" },
+        { 'l', DEBUG_SCANNER },
+        { 'p', DEBUG_PARSER },
+        { 's', DEBUG_SYMBOL },
     };
     const int N_OPTIONS = sizeof (options) / sizeof (options[1]);
     int i, j, n = 0;
     int n_file = 0;
 
     for (i = 1; i < argc; i++) {
-        if (argv[i][0] == '-') {
+        if (argv[i][0] == '-' && argv[i][1] != '\0') {
             switch (argv[i][1]) {
             case 'v':
                 for (j = 0; j < N_OPTIONS; j++) {
@@ -61,7 +64,7 @@ static int parse_command_line(int argc, char *argv[])
                 goto done;
             }
         } else {
-            n += scan_file(argv[i]);
+            n += scan_file(cc, argv[i]);
             n_file++;
         }
 next: ;
@@ -76,9 +79,10 @@ done:
 
 int main(int argc, char *argv[])
 {
+    COMPILER *cc = new_compiler();
     int result;
-    init_symtab();
-    result = parse_command_line(argc, argv);
-    term_symtab();
+    init_symtab(cc);
+    result = parse_command_line(cc, argc, argv);
+    free_compiler(cc);
     return result;
 }
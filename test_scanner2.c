@@ -0,0 +1,3 @@
+/* ".." is not the start of "..." */
+a ... b
+c .. d
@@ -0,0 +1,3 @@
+/* nor is "." a token of its own */
+a ... b
+c . d
@@ -0,0 +1,106 @@
+#include <string.h>
+#include "mcc.h"
+
+/*
+ * token stream
+ * tokens are kept as a struct of arrays: one byte of kind, a 32 bit
+ * value (identifier number or integer literal) and a 32 bit location.
+ */
+
+#define TOKEN_STREAM_INIT_SIZE  1024
+
+TOKEN_STREAM *new_token_stream(const char *filename)
+{
+    TOKEN_STREAM *ts = (TOKEN_STREAM*) alloc(sizeof (TOKEN_STREAM));
+    ts->kind = NULL;
+    ts->value = NULL;
+    ts->loc = NULL;
+    ts->count = 0;
+    ts->capacity = 0;
+    ts->filename = filename;
+    return ts;
+}
+
+void free_token_stream(TOKEN_STREAM *ts)
+{
+    if (ts == NULL)
+        return;
+    free(ts->kind);
+    free(ts->value);
+    free(ts->loc);
+    free(ts);
+}
+
+static void *grow_array(void *old, size_t count, size_t capacity, size_t size)
+{
+    void *p = alloc(capacity * size);
+    if (old != NULL) {
+        memcpy(p, old, count * size);
+        free(old);
+    }
+    return p;
+}
+
+static void grow_token_stream(TOKEN_STREAM *ts)
+{
+    size_t capacity = ts->capacity ? ts->capacity * 2
+                                   : TOKEN_STREAM_INIT_SIZE;
+    ts->kind = (unsigned char*) grow_array(ts->kind, ts->count, capacity,
+                                            sizeof (unsigned char));
+    ts->value = (unsigned*) grow_array(ts->value, ts->count, capacity,
+                                            sizeof (unsigned));
+    ts->loc = (SRCLOC*) grow_array(ts->loc, ts->count, capacity,
+                                            sizeof (SRCLOC));
+    ts->capacity = capacity;
+}
+
+TOKEN lex_token(TOKEN_STREAM *ts, SCANNER *scan)
+{
+    TOKEN tk = next_token(scan);
+    size_t i = ts->count;
+
+    if (i == ts->capacity)
+        grow_token_stream(ts);
+    ts->kind[i] = tk;
+    switch (tk) {
+    case TK_ID:
+        ts->value[i] = ident_number(scan->id);
+        break;
+    case TK_INT_LIT:
+        ts->value[i] = scan->num;
+        break;
+    default:
+        ts->value[i] = 0;
+        break;
+    }
+    ts->loc[i] = scan->loc;
+    ts->count++;
+    return tk;
+}
+
+/* lex the whole input; the stream always ends with TK_EOF */
+void lex_all(TOKEN_STREAM *ts, SCANNER *scan)
+{
+    while (lex_token(ts, scan) != TK_EOF)
+        ;
+}
+
+const char *token_filename(COMPILER *cc, const TOKEN_STREAM *ts, size_t i)
+{
+    return loc_filename(cc, ts->loc[i]);
+}
+
+void fprint_token(COMPILER *cc, FILE *fp, const TOKEN_STREAM *ts, size_t i)
+{
+    switch (ts->kind[i]) {
+    case TK_ID:
+        fprintf(fp, "%s", ident_string(cc, ts->value[i]));
+        break;
+    case TK_INT_LIT:
+        fprintf(fp, "%d", (int) ts->value[i]);
+        break;
+    default:
+        fprintf(fp, "%s", token_to_string(ts->kind[i]));
+        break;
+    }
+}